@@ -0,0 +1,185 @@
+//Array allocators
+//Pluggable memory sources for the OwnedArrays that map, filter, zip and the other allocating operations in array.hpp return.
+
+//By default OwnedArrays use new [] and delete [].  Within the lifetime of an ArrayAllocatorScope, OwnedArrays created on that thread draw from the scope's allocator instead:
+//  ArenaAllocator arena;
+//  {
+//    ArrayAllocatorScope scope(arena);
+//    OwnedArray<float> scaled = arr.map(f);
+//    ...
+//  }
+//  arena.reset(); //Frees every temporary of the request at once.
+
+#ifndef ALLOCATOR_H
+#define ALLOCATOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <new>
+#include <vector>
+
+//Interface for memory sources.  allocate returns bytes of storage aligned to alignment (a power of two no greater than alignof(max_align_t)); deallocate receives the same size and alignment.
+class ArrayAllocator {
+public:
+  virtual ~ArrayAllocator(){ }
+  virtual void* allocate(size_t bytes, size_t alignment) = 0;
+  virtual void deallocate(void* p, size_t bytes, size_t alignment) = 0;
+};
+
+//The allocator new OwnedArrays on this thread draw from, or nullptr for new [].
+inline ArrayAllocator*& currentArrayAllocator(){
+  static thread_local ArrayAllocator* current = nullptr;
+  return current;
+}
+
+//Makes allocator the current allocator of this thread until the scope ends.  Scopes nest.
+class ArrayAllocatorScope {
+public:
+  ArrayAllocatorScope(ArrayAllocator& allocator) : previous(currentArrayAllocator()) {
+    currentArrayAllocator() = &allocator;
+  }
+  ~ArrayAllocatorScope(){
+    currentArrayAllocator() = previous;
+  }
+  ArrayAllocatorScope(const ArrayAllocatorScope&) = delete;
+  ArrayAllocatorScope& operator=(const ArrayAllocatorScope&) = delete;
+
+private:
+  ArrayAllocator* previous;
+};
+
+//Bump pointer arena.  Allocation advances a pointer through large chunks, deallocation does nothing, and reset releases everything at once.
+//Arrays from an arena must not be used (or destroyed after being used) past the next reset, and an arena must not be shared between threads without external locking.
+class ArenaAllocator : public ArrayAllocator {
+public:
+  explicit ArenaAllocator(size_t chunkSize = 1 << 20) : chunkSize(chunkSize), current(0), offset(0) { }
+
+  ~ArenaAllocator(){
+    for(unsigned i = 0; i < chunks.size(); i++){
+      ::operator delete(chunks[i].memory);
+    }
+  }
+
+  ArenaAllocator(const ArenaAllocator&) = delete;
+  ArenaAllocator& operator=(const ArenaAllocator&) = delete;
+
+  void* allocate(size_t bytes, size_t alignment){
+    while(current < chunks.size()){
+      Chunk& c = chunks[current];
+      size_t start = (offset + alignment - 1) & ~(alignment - 1);
+      if(start + bytes <= c.size){
+        offset = start + bytes;
+        return (char*)c.memory + start;
+      }
+      current++;
+      offset = 0;
+    }
+    //Oversized requests get a chunk of their own.
+    Chunk c;
+    c.size = (bytes > chunkSize) ? bytes : chunkSize;
+    c.memory = ::operator new(c.size);
+    chunks.push_back(c);
+    current = chunks.size() - 1;
+    offset = bytes;
+    return c.memory;
+  }
+
+  void deallocate(void*, size_t, size_t){ }
+
+  //Makes all chunks available again, keeping them for reuse.
+  void reset(){
+    current = 0;
+    offset = 0;
+  }
+
+  //Returns the memory of every chunk but the first to the system.
+  void shrink(){
+    for(unsigned i = 1; i < chunks.size(); i++){
+      ::operator delete(chunks[i].memory);
+    }
+    if(chunks.size() > 1) chunks.resize(1);
+    reset();
+  }
+
+  //Total bytes reserved from the system.
+  size_t capacity() const {
+    size_t total = 0;
+    for(unsigned i = 0; i < chunks.size(); i++){
+      total += chunks[i].size;
+    }
+    return total;
+  }
+
+private:
+  struct Chunk {
+    void* memory;
+    size_t size;
+  };
+
+  size_t chunkSize;
+  std::vector<Chunk> chunks;
+  size_t current;
+  size_t offset;
+};
+
+//Size class pool.  Requests are rounded up to a power of two of at least 64 bytes, and freed blocks are kept on a free list per size class, so arrays of recurring lengths are recycled without going to the global allocator.
+//Requests larger than maxPooledBytes go straight to operator new.  A pool must not be shared between threads without external locking.
+class PoolAllocator : public ArrayAllocator {
+public:
+  explicit PoolAllocator(size_t maxPooledBytes = 1 << 24) : maxPooledBytes(maxPooledBytes) { }
+
+  ~PoolAllocator(){
+    trim();
+  }
+
+  PoolAllocator(const PoolAllocator&) = delete;
+  PoolAllocator& operator=(const PoolAllocator&) = delete;
+
+  void* allocate(size_t bytes, size_t){
+    if(bytes > maxPooledBytes) return ::operator new(bytes);
+    unsigned c = sizeClass(bytes);
+    if(c < freeLists.size() && !freeLists[c].empty()){
+      void* p = freeLists[c].back();
+      freeLists[c].pop_back();
+      return p;
+    }
+    return ::operator new(classBytes(c));
+  }
+
+  void deallocate(void* p, size_t bytes, size_t){
+    if(bytes > maxPooledBytes){
+      ::operator delete(p);
+      return;
+    }
+    unsigned c = sizeClass(bytes);
+    if(c >= freeLists.size()) freeLists.resize(c + 1);
+    freeLists[c].push_back(p);
+  }
+
+  //Returns all free blocks to the system.
+  void trim(){
+    for(unsigned c = 0; c < freeLists.size(); c++){
+      for(unsigned i = 0; i < freeLists[c].size(); i++){
+        ::operator delete(freeLists[c][i]);
+      }
+      freeLists[c].clear();
+    }
+  }
+
+private:
+  static const unsigned minClassShift = 6;
+
+  static unsigned sizeClass(size_t bytes){
+    unsigned c = 0;
+    while(classBytes(c) < bytes) c++;
+    return c;
+  }
+  static size_t classBytes(unsigned c){
+    return (size_t)1 << (c + minClassShift);
+  }
+
+  size_t maxPooledBytes;
+  std::vector<std::vector<void*> > freeLists;
+};
+
+#endif
@@ -8,25 +8,396 @@
 #include <algorithm>
 #include <thread>
 #include <random>
+#include <type_traits>
+#include <utility>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+
+#include "threadpool.hpp"
+#include "allocator.hpp"
+#include "simd.hpp"
+
+//Checking policy
+//Checks are in two groups, each switched on or off for the whole build independently of NDEBUG (which only sets their defaults, matching assert):
+//VMATH_BOUNDS_CHECKS covers indexing and sub-ranges of Arrays, StridedArrays and Matrices, and the lengths of the arrays passed to map, zip and the like.
+//VMATH_CONTRACT_CHECKS covers what the higher order operators require of their functions, such as the commutativity of foldUnordered's.
+//Define either as 1 or 0 to override, for example -DNDEBUG -DVMATH_CONTRACT_CHECKS=1 in a staging build.  Failed checks print the condition and abort.
+//The library's own bulk loops index through raw pointers rather than operator[], so they compile to the same code with bounds checks on or off; at(i) is checked in every build.
+#ifndef VMATH_BOUNDS_CHECKS
+#ifdef NDEBUG
+#define VMATH_BOUNDS_CHECKS 0
+#else
+#define VMATH_BOUNDS_CHECKS 1
+#endif
+#endif
+
+#ifndef VMATH_CONTRACT_CHECKS
+#ifdef NDEBUG
+#define VMATH_CONTRACT_CHECKS 0
+#else
+#define VMATH_CONTRACT_CHECKS 1
+#endif
+#endif
+
+inline void vmathCheckFailed(const char* kind, const char* condition, const char* file, unsigned line){
+  fprintf(stderr, "%s:%u: %s check failed: %s\n", file, line, kind, condition);
+  abort();
+}
+
+#define VMATH_CHECK(kind, condition) ((condition) ? (void)0 : vmathCheckFailed(kind, #condition, __FILE__, __LINE__))
+
+#if VMATH_BOUNDS_CHECKS
+#define VMATH_CHECK_BOUNDS(condition) VMATH_CHECK("Bounds", condition)
+#else
+#define VMATH_CHECK_BOUNDS(condition) ((void)0)
+#endif
+
+#if VMATH_CONTRACT_CHECKS
+#define VMATH_CHECK_CONTRACT(condition) VMATH_CHECK("Contract", condition)
+#else
+#define VMATH_CHECK_CONTRACT(condition) ((void)0)
+#endif
+
+//The (decayed) type returned by calling an F with lvalues of the given argument types.
+template <typename F, typename... Args> using CallResult = typename std::decay<decltype(std::declval<F&>()(std::declval<Args&>()...))>::type;
+
+template <typename T> struct OwnedArray;
+
+//Size type
+//Lengths of and indices into Arrays (and the views and functions built on them) have type ArraySize, which is size_t unless VMATH_SIZE_TYPE is defined to another unsigned type before the headers are included.
+//Partition and thread counts stay unsigned.
+#ifndef VMATH_SIZE_TYPE
+#define VMATH_SIZE_TYPE size_t
+#endif
+typedef VMATH_SIZE_TYPE ArraySize;
+
+//Execution policies select how an operation that has several implementations runs.
+//SequentialPolicy runs the plain loop on the calling thread, and VectorizedPolicy a loop restructured for SIMD on the calling thread.
+struct SequentialPolicy { };
+struct VectorizedPolicy { };
+
+//Execution policy for operations that can run on the global thread pool (see threadpool.hpp).
+//The work is split into partitionCount ranges, unless there are fewer than minToMultithread elements, in which case it runs on the calling thread.
+struct ParallelPolicy {
+  unsigned partitionCount;
+  unsigned minToMultithread;
+
+  explicit ParallelPolicy(unsigned partitionCount = ThreadPool::global().concurrency(), unsigned minToMultithread = 1 << 14) : partitionCount(partitionCount), minToMultithread(minToMultithread) { }
+};
+
+//Execution policy for operations whose cost per element varies widely.  The work is cut into chunks of grainSize elements, which the threads of the global pool claim one at a time (see ThreadPool::run), so a thread that draws expensive elements takes fewer chunks and all threads finish together.
+//A grainSize of 0 chooses the grain from the measured cost of the first elements, and runs on the calling thread when the whole job costs less than handing it to the pool would (see Array::mapParallel).
+struct DynamicPolicy {
+  ArraySize grainSize;
+
+  explicit DynamicPolicy(ArraySize grainSize = 0) : grainSize(grainSize) { }
+};
+
+//Cost model of the automatic grain: elements are mapped serially until they have taken MAP_PROBE_NANOSECONDS, about the cost of waking the pool, and if any remain, chunks are sized to take about MAP_CHUNK_NANOSECONDS each (far above the cost of claiming one) while leaving at least MAP_CHUNKS_PER_THREAD chunks per thread to balance.
+#define MAP_PROBE_NANOSECONDS 20000
+#define MAP_CHUNK_NANOSECONDS 50000
+#define MAP_CHUNKS_PER_THREAD 8
+
+//The 128 bit product of a and b, from 32 bit halves: returns the low 64 bits and sets high to the high 64.
+inline uint64_t multiplyWideHalves(uint64_t a, uint64_t b, uint64_t& high){
+  uint64_t aLow = a & 0xffffffffull, aHigh = a >> 32, bLow = b & 0xffffffffull, bHigh = b >> 32;
+  uint64_t lowLow = aLow * bLow, lowHigh = aLow * bHigh, highLow = aHigh * bLow;
+  uint64_t middle = (lowLow >> 32) + (lowHigh & 0xffffffffull) + (highLow & 0xffffffffull);
+  high = aHigh * bHigh + (lowHigh >> 32) + (highLow >> 32) + (middle >> 32);
+  return (middle << 32) | (lowLow & 0xffffffffull);
+}
+
+//As multiplyWideHalves, in a single multiplication where the compiler has 128 bit integers (a GNU extension, so it is only used where __SIZEOF_INT128__ says it exists).
+inline uint64_t multiplyWide(uint64_t a, uint64_t b, uint64_t& high){
+#ifdef __SIZEOF_INT128__
+  __extension__ typedef unsigned __int128 Wide;
+  Wide m = (Wide)a * b;
+  high = (uint64_t)(m >> 64);
+  return (uint64_t)m;
+#else
+  return multiplyWideHalves(a, b, high);
+#endif
+}
+
+//Maps an arithmetic key to an unsigned integer of the same size with the same ordering, for radix sorting.
+//Negative floating point values have all their bits flipped and the rest have only the sign bit set, which places -0 before 0, NaNs with the sign bit set before everything else, and other NaNs after everything else.
+template <typename T, typename Enable = void> struct RadixKey;
+template <typename T> struct RadixKey<T, typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value>::type> {
+  typedef typename std::make_unsigned<T>::type type;
+  static type get(T v){
+    return std::is_signed<T>::value ? (type)((type)v ^ ((type)1 << (8 * sizeof(T) - 1))) : (type)v;
+  }
+};
+template <typename T> struct RadixKey<T, typename std::enable_if<std::is_floating_point<T>::value && (sizeof(T) == 4 || sizeof(T) == 8)>::type> {
+  typedef typename std::conditional<sizeof(T) == 4, uint32_t, uint64_t>::type type;
+  static type get(T v){
+    type bits;
+    memcpy(&bits, &v, sizeof(T));
+    const type sign = (type)1 << (8 * sizeof(T) - 1);
+    return (bits & sign) ? ~bits : (bits | sign);
+  }
+};
+
+//Bit arrays
+//A BitArray packs one bit per element into 64 bit words: an eighth of the memory of an array of bools, and combined and counted a word (on x86-64, a vector of words) at a time.
+//Masks for filter and for the switched distances in vectormath.hpp are made with Array::predicateMask.
+typedef uint64_t BitWord;
+
+//Index of the lowest set bit of w, which must not be 0.
+inline unsigned lowestSetBit(BitWord w){
+#if defined(__GNUC__) || defined(__clang__)
+  return __builtin_ctzll(w);
+#else
+  unsigned i = 0;
+  while(!(w & 1)){
+    w >>= 1;
+    i++;
+  }
+  return i;
+#endif
+}
+
+//Word operations for combineBits.  Each applies to single words and to vectors of words alike.
+struct BitAnd {
+  template<typename W> static SIMD_INLINE void apply(W& x, const W& y){ x &= y; }
+};
+struct BitOr {
+  template<typename W> static SIMD_INLINE void apply(W& x, const W& y){ x |= y; }
+};
+struct BitXor {
+  template<typename W> static SIMD_INLINE void apply(W& x, const W& y){ x ^= y; }
+};
+struct BitAndNot {
+  template<typename W> static SIMD_INLINE void apply(W& x, const W& y){ x &= ~y; }
+};
+
+//Sets out[i] to a[i] Op b[i] for each of the n words.  out may be a or b.
+template<typename Op> void combineBits(BitWord* out, const BitWord* a, const BitWord* b, ArraySize n){
+#ifdef VMATH_SIMD
+  simdDispatch<SimdBitwise>(Op(), out, a, b, (size_t)n);
+#else
+  for(ArraySize i = 0; i < n; i++){
+    BitWord x = a[i];
+    Op::apply(x, b[i]);
+    out[i] = x;
+  }
+#endif
+}
+
+//Number of set bits in the n words of w.
+inline ArraySize countBits(const BitWord* w, ArraySize n){
+#ifdef VMATH_SIMD
+  return simdDispatch<SimdBitCount>(w, (size_t)n);
+#else
+  ArraySize count = 0;
+  for(ArraySize i = 0; i < n; i++){
+    for(BitWord x = w[i]; x != 0; x &= x - 1){
+      count++;
+    }
+  }
+  return count;
+#endif
+}
+
+struct BitArray {
+  static const unsigned wordBits = 64;
+
+  //Fields
+  ArraySize length;
+  std::vector<BitWord> words; //Bit i is bit i % wordBits of words[i / wordBits].  Bits past length in the last word are kept clear, so whole word operations never see stray bits.
+
+  //Constructors
+  BitArray() : length(0) { }
+
+  //All bits clear, or all set if value is true.
+  explicit BitArray(ArraySize length, bool value = false) : length(length), words(wordCount(length), value ? ~(BitWord)0 : 0) {
+    clearTail();
+  }
+
+  //Bit i set where flags[i] is true.
+  static BitArray fromBools(const bool* flags, ArraySize length){
+    BitArray out(length);
+    for(ArraySize i = 0; i < length; i++){
+      out.words[i / wordBits] |= (BitWord)flags[i] << (i % wordBits);
+    }
+    return out;
+  }
+
+  static ArraySize wordCount(ArraySize length){
+    return length / wordBits + (length % wordBits != 0);
+  }
+
+  //Accessors
+  bool operator[](ArraySize i) const {
+    VMATH_CHECK_BOUNDS(i < length);
+    return (words[i / wordBits] >> (i % wordBits)) & 1;
+  }
+
+  void set(ArraySize i, bool value = true){
+    VMATH_CHECK_BOUNDS(i < length);
+    BitWord bit = (BitWord)1 << (i % wordBits);
+    BitWord& w = words[i / wordBits];
+    w = value ? (w | bit) : (w & ~bit);
+  }
+
+  void reset(ArraySize i){
+    set(i, false);
+  }
+
+  void fill(bool value){
+    std::fill(words.begin(), words.end(), value ? ~(BitWord)0 : 0);
+    clearTail();
+  }
+
+  //Counting and searching
+
+  //Number of set bits.
+  ArraySize count() const {
+    return countBits(words.data(), words.size());
+  }
+
+  bool any() const {
+    for(ArraySize w = 0; w < words.size(); w++){
+      if(words[w] != 0) return true;
+    }
+    return false;
+  }
+
+  //Index of the first set bit at or after from, or length if there is none.
+  ArraySize findNext(ArraySize from) const {
+    if(from >= length) return length;
+    ArraySize w = from / wordBits;
+    BitWord bits = words[w] & (~(BitWord)0 << (from % wordBits));
+    while(bits == 0){
+      if(++w == words.size()) return length;
+      bits = words[w];
+    }
+    return w * wordBits + lowestSetBit(bits);
+  }
+
+  //Calls f(i) for each set bit i, in increasing order.  Clear bits cost nothing beyond their word's test.
+  template<class F> void forEachSet(F f) const {
+    for(ArraySize w = 0; w < words.size(); w++){
+      for(BitWord bits = words[w]; bits != 0; bits &= bits - 1){
+        f(w * wordBits + lowestSetBit(bits));
+      }
+    }
+  }
+
+  //Equality
+  bool operator==(const BitArray& other) const {
+    return length == other.length && words == other.words;
+  }
+  bool operator!=(const BitArray& other) const {
+    return !operator==(other);
+  }
+
+  //Bitwise operators.  Both operands must have the same length.
+  BitArray& operator&=(const BitArray& other){
+    return combineWith<BitAnd>(other);
+  }
+  BitArray& operator|=(const BitArray& other){
+    return combineWith<BitOr>(other);
+  }
+  BitArray& operator^=(const BitArray& other){
+    return combineWith<BitXor>(other);
+  }
+  //Clears the bits that are set in other.
+  BitArray& andNot(const BitArray& other){
+    return combineWith<BitAndNot>(other);
+  }
+
+  BitArray operator&(const BitArray& other) const {
+    return combined<BitAnd>(other);
+  }
+  BitArray operator|(const BitArray& other) const {
+    return combined<BitOr>(other);
+  }
+  BitArray operator^(const BitArray& other) const {
+    return combined<BitXor>(other);
+  }
+  BitArray operator~() const {
+    BitArray out(length, true);
+    combineBits<BitAndNot>(out.words.data(), out.words.data(), words.data(), words.size());
+    return out;
+  }
+
+private:
+  template<typename Op> BitArray& combineWith(const BitArray& other){
+    VMATH_CHECK_BOUNDS(length == other.length);
+    combineBits<Op>(words.data(), words.data(), other.words.data(), words.size());
+    return *this;
+  }
+
+  template<typename Op> BitArray combined(const BitArray& other) const {
+    VMATH_CHECK_BOUNDS(length == other.length);
+    BitArray out(length);
+    combineBits<Op>(out.words.data(), words.data(), other.words.data(), words.size());
+    return out;
+  }
+
+  void clearTail(){
+    if(length % wordBits != 0) words.back() &= ((BitWord)1 << (length % wordBits)) - 1;
+  }
+};
+
+//The word with bit j set where flags[j] is 1, for 64 flags that are each 0 or 1.
+//On little endian targets eight flags are loaded as one integer, and a multiply moves flag k from bit 8k to bit 56 + k without any two partial products overlapping.
+inline BitWord packFlags(const uint8_t* flags){
+  BitWord bits = 0;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  for(unsigned k = 0; k < 8; k++){
+    uint64_t x;
+    memcpy(&x, flags + 8 * k, 8);
+    bits |= ((x * 0x0102040810204080ull) >> 56) << (8 * k);
+  }
+#else
+  for(unsigned j = 0; j < 64; j++){
+    bits |= (BitWord)flags[j] << j;
+  }
+#endif
+  return bits;
+}
+
+//Copies data[i] to out for each set bit i in words [firstWord, lastWord) of a BitArray's words, in order, and returns the end of the output.
+//Full words are copied as a block and the others visit only their set bits, so there is no branch per element to mispredict.
+template<typename T> T* selectBits(T* out, const T* data, const BitWord* words, ArraySize firstWord, ArraySize lastWord){
+  for(ArraySize w = firstWord; w < lastWord; w++){
+    const T* d = data + w * BitArray::wordBits;
+    BitWord bits = words[w];
+    if(bits == ~(BitWord)0){
+      out = std::copy(d, d + BitArray::wordBits, out);
+      continue;
+    }
+    for(; bits != 0; bits &= bits - 1){
+      *out++ = d[lowestSetBit(bits)];
+    }
+  }
+  return out;
+}
 
 //This templated array class allows some classic higher order functions, and optionally provides some run time safety with bounds checking.
 template <typename T> struct Array {
   //Fields
-  unsigned length;
+  ArraySize length;
   T* data;
   
   //Constructors
-  Array(unsigned length, T* data) : length(length), data(data) { }
-  Array(T* data, unsigned length) : length(length), data(data) { }
+  Array(ArraySize length, T* data) : length(length), data(data) { }
+  Array(T* data, ArraySize length) : length(length), data(data) { }
   
   //Empty array (Warning: No initialization)
-  Array(unsigned length) : length(length) {
+  Array(ArraySize length) : length(length) {
     data = new T[length];
   }
   
   //Initialize array to value
-  Array(unsigned length, T val) : Array(length) {
-    for(unsigned i = 0; i < length; i++){
+  Array(ArraySize length, T val) : Array(length) {
+    for(ArraySize i = 0; i < length; i++){
       data[i] = val;
     }
   }
@@ -35,7 +406,7 @@ template <typename T> struct Array {
   Array(std::vector<T>& vec){
     length = vec.size();
     data = new T[length];
-    for(unsigned i = 0; i < length; i++){
+    for(ArraySize i = 0; i < length; i++){
       data[i] = vec[i];
     }
   }
@@ -47,23 +418,34 @@ template <typename T> struct Array {
   //Initializationless constructor
   Array(){}
 
+  //Takes over the memory of an OwnedArray temporary, such as the result of map, filter or zip, when written out as Array<T> x(arr.map(f)); the same as Array<T> x = arr.map(f).release().
+  //It is explicit so that temporaries passed to Array parameters, as in sumTerms(arr.map(f)), are only viewed, and freed by the OwnedArray at the end of the expression.
+  //Beware that Array<T> x = arr.map(f); is such a view too, and dangles once the statement ends: store the result in an OwnedArray instead.
+  explicit Array(OwnedArray<T>&& owned);
+
   //Accessors
-  T & operator[](unsigned index) const {
-    assert(index < length); //The type system takes care of negative indices.
+  T & operator[](ArraySize index) const {
+    VMATH_CHECK_BOUNDS(index < length); //The type system takes care of negative indices.
+    return data[index];
+  }
+
+  //As operator[], but checked whatever the checking policy.
+  T & at(ArraySize index) const {
+    VMATH_CHECK("Bounds", index < length);
     return data[index];
   }
 
   //Equality
 
-  bool operator==(const Array<T> other) const {
+  bool operator==(const Array<T>& other) const {
     if(length != other.length) return false;
-    for(unsigned i = 0; i < length; i++){
-      if(data[i] != other[i]) return false;
+    for(ArraySize i = 0; i < length; i++){
+      if(data[i] != other.data[i]) return false;
     }
     return true;
   }
 
-  bool operator!=(const Array<T> other) const {
+  bool operator!=(const Array<T>& other) const {
     return !operator==(other);
   }
 
@@ -75,48 +457,48 @@ template <typename T> struct Array {
       return;
     }
     out << "{" << data[0];
-    for(unsigned i = 1; i < length; i++){
+    for(ArraySize i = 1; i < length; i++){
       out << ", " << data[i];
     }
     out << "}";
   }
 
   //Functional Creators
-  Array<T> slice(unsigned first) { //Technically this could be const, but such would seem to violate the spirit of the thing.
-    assert(first <= length);
+  Array<T> slice(ArraySize first) { //Technically this could be const, but such would seem to violate the spirit of the thing.
+    VMATH_CHECK_BOUNDS(first <= length);
     return Array<T>(data + first, length - first);
   }
 
   //Basically alternative syntax to slice, more C like.
-  Array<T> operator+(unsigned addand) {
+  Array<T> operator+(ArraySize addand) {
     return slice(addand);
   }
 
   //Gives a new array from [first, last)
-  Array<T> slice(unsigned first, unsigned last){
-    assert(first <= length);
-    assert(last <= length);
+  Array<T> slice(ArraySize first, ArraySize last){
+    VMATH_CHECK_BOUNDS(first <= length);
+    VMATH_CHECK_BOUNDS(last <= length);
     return Array<T>(data + first, last - first);
   }
 
   //Head and tail, to operate like a functional list.
   T head() const {
-    assert(length > 0);
+    VMATH_CHECK_BOUNDS(length > 0);
     return data[0];
   }
 
   Array<T> tail() const {
-    assert(length > 0);
+    VMATH_CHECK_BOUNDS(length > 0);
     return Array(data + 1, length - 1);
   }
 
-  Array<T> take(unsigned count) {
-    assert(count <= length);
+  Array<T> take(ArraySize count) {
+    VMATH_CHECK_BOUNDS(count <= length);
     return Array<T>(data, count);
   }
 
-  Array<T> drop(unsigned count) {
-    assert(count <= length);
+  Array<T> drop(ArraySize count) {
+    VMATH_CHECK_BOUNDS(count <= length);
     return Array<T>(data + count, length - count);
   }
 
@@ -127,218 +509,782 @@ template <typename T> struct Array {
     std::sort(data, data + length);
   }
 
+  //Parallel sort: each of the policy's partitions is sorted with std::sort on the global thread pool, and the sorted runs are then merged pairwise.
+  //Every merge is itself split across the pool, by cutting the output at evenly spaced points and binary searching where each cut falls in the two runs.
+  //Uses a temporary buffer the size of the array.
+  void sort(const ParallelPolicy& policy){
+    VMATH_INSTRUMENT_SCOPE("sort", length);
+    unsigned partitionCount = (unsigned)std::min<ArraySize>(policy.partitionCount, length);
+    if(length < policy.minToMultithread || partitionCount < 2){
+      sort();
+      return;
+    }
+    const Array<T> self = *this;
+    ThreadPool::global().run(partitionCount, [self, partitionCount](unsigned i){
+      std::sort(self.data + partitionBound(i, self.length, partitionCount), self.data + partitionBound(i + 1, self.length, partitionCount));
+    });
+
+    OwnedArray<T> buffer = OwnedArray<T>(length);
+    T* src = data;
+    T* dst = buffer.data;
+    for(unsigned width = 1; width < partitionCount; width *= 2){
+      for(unsigned i = 0; i < partitionCount; i += 2 * width){
+        ArraySize first = partitionBound(i, length, partitionCount);
+        ArraySize middle = partitionBound(std::min(i + width, partitionCount), length, partitionCount);
+        ArraySize last = partitionBound(std::min(i + 2 * width, partitionCount), length, partitionCount);
+        mergeParallel(src + first, middle - first, src + middle, last - middle, dst + first, policy.partitionCount);
+      }
+      std::swap(src, dst);
+    }
+    if(src != data){
+      ThreadPool::global().run(partitionCount, [self, src, partitionCount](unsigned i){
+        ArraySize first = partitionBound(i, self.length, partitionCount);
+        std::copy(src + first, src + partitionBound(i + 1, self.length, partitionCount), self.data + first);
+      });
+    }
+  }
+
+  //Sorts arithmetic keys by their bits, one byte per pass from least to most significant (LSD radix sort), in time linear in length * sizeof(T).
+  //Passes over bytes that are equal in every key are skipped.  The order matches sort() apart from ties between -0 and 0 and the placement of NaNs (see RadixKey).
+  //Uses a temporary buffer the size of the array.
+  void radixSort(){
+    radixSort(ParallelPolicy(1));
+  }
+
+  //As radixSort(), with the counting and scattering of each pass split into the policy's partitions on the global thread pool.
+  //Each partition scatters its range in order to offsets reserved for it, so every pass stays stable.
+  void radixSort(const ParallelPolicy& policy){
+    VMATH_INSTRUMENT_SCOPE("radixSort", length);
+    typedef typename RadixKey<T>::type Key;
+    const unsigned passCount = sizeof(Key);
+    unsigned partitionCount = (unsigned)std::min<ArraySize>(policy.partitionCount, length);
+    if(length < policy.minToMultithread || partitionCount < 2) partitionCount = 1;
+    if(length < 2) return;
+
+    //counts[(p * passCount + pass) * 256 + digit]: the number of keys of partition p with the given digit in the given pass.
+    std::vector<ArraySize> counts((size_t)partitionCount * passCount * 256);
+    countRadixDigits(data, counts.data(), partitionCount, 0, passCount);
+
+    OwnedArray<T> buffer = OwnedArray<T>(length);
+    T* src = data;
+    T* dst = buffer.data;
+    for(unsigned pass = 0; pass < passCount; pass++){
+      //Totals don't depend on the order, so the first count tells which passes would leave the keys unchanged.
+      bool trivial = false;
+      for(unsigned digit = 0; digit < 256 && !trivial; digit++){
+        ArraySize total = 0;
+        for(unsigned p = 0; p < partitionCount; p++){
+          total += counts[(p * passCount + pass) * 256 + digit];
+        }
+        trivial = (total == length);
+        if(total != 0) break;
+      }
+      if(trivial) continue;
+
+      //The partitions' ranges have changed since the first count, so recount this pass.
+      if(partitionCount > 1 && pass > 0) countRadixDigits(src, counts.data(), partitionCount, pass, pass + 1);
+      std::vector<ArraySize> offsets((size_t)partitionCount * 256);
+      ArraySize offset = 0;
+      for(unsigned digit = 0; digit < 256; digit++){
+        for(unsigned p = 0; p < partitionCount; p++){
+          offsets[p * 256 + digit] = offset;
+          offset += counts[(p * passCount + pass) * 256 + digit];
+        }
+      }
+      ArraySize* offs = offsets.data();
+      ArraySize len = length;
+      const unsigned shift = 8 * pass;
+      ThreadPool::global().run(partitionCount, [src, dst, offs, len, partitionCount, shift](unsigned p){
+        ArraySize* o = offs + p * 256;
+        ArraySize last = partitionBound(p + 1, len, partitionCount);
+        for(ArraySize i = partitionBound(p, len, partitionCount); i < last; i++){
+          dst[o[(RadixKey<T>::get(src[i]) >> shift) & 255]++] = src[i];
+        }
+      });
+      std::swap(src, dst);
+    }
+    if(src != data) std::copy(src, src + length, data);
+  }
+
   //Shuffle the contents of the array with a random number generator.
   template <class URNG> void shuffle(URNG&& r){
     std::shuffle(data, data + length, r);
   }
+
+  //Parallel shuffle: each of the policy's partitions sends each of its elements to a random one of partitionCount buckets, the buckets are laid out one after another, and each bucket is then shuffled.
+  //The result is a uniformly random permutation that depends only on seed and partitionCount (arrays under minToMultithread are shuffled serially, as with a partitionCount of 1), using std::mt19937_64 streams and no standard distributions, so it is the same on every platform.
+  //Uses a temporary buffer the size of the array.
+  void shuffle(uint64_t seed, const ParallelPolicy& policy){
+    VMATH_INSTRUMENT_SCOPE("shuffle", length);
+    unsigned partitionCount = (unsigned)std::min<ArraySize>(policy.partitionCount, length);
+    if(length < policy.minToMultithread || partitionCount < 2){
+      std::mt19937_64 r(shuffleStreamSeed(seed, 0));
+      shuffleRange(data, length, r);
+      return;
+    }
+
+    //counts[p * partitionCount + b]: the number of elements partition p sends to bucket b.  Each partition's draws come from its own stream, and are replayed for the scatter.
+    std::vector<ArraySize> counts((size_t)partitionCount * partitionCount);
+    ArraySize* c = counts.data();
+    const Array<T> self = *this;
+    ThreadPool::global().run(partitionCount, [self, c, seed, partitionCount](unsigned p){
+      std::mt19937_64 r(shuffleStreamSeed(seed, p));
+      ArraySize last = partitionBound(p + 1, self.length, partitionCount);
+      for(ArraySize i = partitionBound(p, self.length, partitionCount); i < last; i++){
+        c[p * partitionCount + randomBelow(r, partitionCount)]++;
+      }
+    });
+    std::vector<ArraySize> offsets((size_t)partitionCount * partitionCount);
+    std::vector<ArraySize> bucketStarts(partitionCount + 1);
+    ArraySize offset = 0;
+    for(unsigned b = 0; b < partitionCount; b++){
+      bucketStarts[b] = offset;
+      for(unsigned p = 0; p < partitionCount; p++){
+        offsets[p * partitionCount + b] = offset;
+        offset += c[p * partitionCount + b];
+      }
+    }
+    bucketStarts[partitionCount] = offset;
+
+    OwnedArray<T> buffer = OwnedArray<T>(length);
+    T* dst = buffer.data;
+    ArraySize* offs = offsets.data();
+    ThreadPool::global().run(partitionCount, [self, dst, offs, seed, partitionCount](unsigned p){
+      std::mt19937_64 r(shuffleStreamSeed(seed, p));
+      ArraySize* o = offs + p * partitionCount;
+      ArraySize last = partitionBound(p + 1, self.length, partitionCount);
+      for(ArraySize i = partitionBound(p, self.length, partitionCount); i < last; i++){
+        dst[o[randomBelow(r, partitionCount)]++] = self.data[i];
+      }
+    });
+    const ArraySize* starts = bucketStarts.data();
+    ThreadPool::global().run(partitionCount, [self, dst, starts, seed, partitionCount](unsigned b){
+      std::mt19937_64 r(shuffleStreamSeed(seed, partitionCount + b));
+      shuffleRange(dst + starts[b], starts[b + 1] - starts[b], r);
+      std::copy(dst + starts[b], dst + starts[b + 1], self.data + starts[b]);
+    });
+  }
   
   //Functional Operators:
+  //Each operator takes its function as a template parameter, so function pointers, functors and lambdas (including capturing lambdas) are all accepted, and the latter two are inlined into the loop.
+  //The older closure forms, which pass a function pointer and a separate cl argument, forward to these with a lambda binding cl.
 
   //Predicates
 
-  bool conjunction(bool (*f)(const T)) const{
-    for(unsigned i = 0; i < length; i++){
+  template<typename F> bool conjunction(F f) const{
+    for(ArraySize i = 0; i < length; i++){
       if(!f(data[i])) return false;
     }
     return true;
   }
   
   template<typename Cl> bool conjunction(bool (*f)(const T, const Cl), const Cl cl) const{
-    for(unsigned i = 0; i < length; i++){
-      if(!f(data[i], cl)) return false;
-    }
-    return true;
+    return conjunction([f, cl](const T t){return f(t, cl);});
   }
   
-  bool disjunction(bool (*f)(const T)) const{
-    for(unsigned i = 0; i < length; i++){
+  template<typename F> bool disjunction(F f) const{
+    for(ArraySize i = 0; i < length; i++){
       if(f(data[i])) return true;
     }
     return false;
   }
   
   template<typename Cl> bool disjunction(bool (*f)(const T, const Cl), const Cl cl) const{
-    for(unsigned i = 0; i < length; i++){
-      if(f(data[i], cl)) return true;
-    }
-    return false;
+    return disjunction([f, cl](const T t){return f(t, cl);});
+  }
+
+  //Evaluates f on every element into a BitArray, bit i holding f(data[i]).
+  //The results are packed without branching (see predicateWords), so at -O3 simple predicates compile to vector compares.
+  template<typename F> BitArray predicateMask(F f) const{
+    BitArray mask(length);
+    predicateWords(f, mask.words.data(), 0, mask.words.size());
+    return mask;
+  }
+
+  //As predicateMask(f), with the words of the mask split into the policy's partitions on the global thread pool.
+  template<typename F> BitArray predicateMask(F f, const ParallelPolicy& policy) const{
+    VMATH_INSTRUMENT_SCOPE("predicateMask", length);
+    return predicateMaskPartitioned(f, (length < policy.minToMultithread) ? 1 : policy.partitionCount);
   }
 
   ////////////
   //MAP FAMILY
   
-  template<class U> Array<U> map( U (*f)(const T)) const{
-      Array<U> newArr = Array<U>(length);
-      return mapTo(f, newArr);
+  //The result type may be given explicitly (map<U>(f)), otherwise it is the type f returns.
+  template<class U, class F> OwnedArray<U> map(F f) const{
+      OwnedArray<U> newArr = OwnedArray<U>(length);
+      mapTo(f, newArr.view());
+      return newArr;
+  }
+  template<class F> auto map(F f) const -> OwnedArray<CallResult<F, T>>{
+      return map<CallResult<F, T>>(f);
   }
   
-  template<class U> Array<U> mapTo( U (*f)(const T), Array<U> out) const{
-      assert(out.length == length);
-      for(unsigned i = 0; i < length; i++){
-          out[i] = (*f)(data[i]);
+  template<class U, class F> Array<U> mapTo(F f, Array<U> out) const{
+      VMATH_CHECK_BOUNDS(out.length == length);
+      U* o = out.data;
+      for(ArraySize i = 0; i < length; i++){
+          o[i] = f(data[i]);
       }
       return out;
   }
   
-  Array<T> mapInPlace(T (*f)(const T)) {
-      mapTo(f, this);
+  template<class F> Array<T> mapInPlace(F f) {
+      return mapTo(f, *this);
   }
 
  
   //With closure: 
-  template<class U, class V> Array<U> map( U (*f)(const T, const V cl), const V cl) const{
-      Array<U> newArr = Array<U>(length);
-      return mapTo(f, cl, newArr);
+  template<class U, class V> OwnedArray<U> map( U (*f)(const T, const V cl), const V cl) const{
+      return map<U>([f, cl](const T t){return f(t, cl);});
   }
   
   template<class U, class V> Array<U> mapTo( U (*f)(const T, const V cl), const V cl, Array<U> out) const{
-      assert(out.length == length);
-      for(unsigned i = 0; i < length; i++){
-          out[i] = (*f)(data[i], cl);
-      }
-      return out;
+      return mapTo([f, cl](const T t){return f(t, cl);}, out);
   }
   
   //Parallelized Map
   
-  template<class U> Array<U> mapParallel(U (*f)(const T), unsigned threadCount, unsigned minToMultithread) const {
-    //Launch new threads, each doing their own map.
+  //Splits the array into partitionCount ranges and maps them on the global thread pool (see threadpool.hpp), with the calling thread taking one of the ranges.
+  template<class U, class F> OwnedArray<U> mapParallel(F f, unsigned partitionCount, unsigned minToMultithread) const {
+    VMATH_INSTRUMENT_SCOPE("mapParallel", length);
     if(length < minToMultithread){
-      return map(f);
+      return map<U>(f);
     }
     
-    Array<U> result = Array<U>(length);
-
-    std::vector<std::thread> threads;
-    threads.reserve(threadCount);
-
-    for(unsigned i = 0; i < threadCount; i++){
-      unsigned start = (i * length) / threadCount;
-      unsigned finish = ((i + 1) * length) / threadCount;
-      unsigned subLen = finish - start;
-      
-      threads.push_back(std::thread([this, f, start, subLen, result](){Array(data + start, subLen).mapTo(f, Array<U>(result.data + start, subLen));}));
-    }
+    OwnedArray<U> owned = OwnedArray<U>(length);
+    const Array<U> result = owned.view();
+    const Array<T> self = *this;
 
-    //Optimization: have the main thread work too?
-    std::for_each(threads.begin(), threads.end(), [](std::thread &t) 
-    {
-      t.join();
+    ThreadPool::global().run(partitionCount, [self, f, partitionCount, result](unsigned i){
+      ArraySize start = partitionBound(i, self.length, partitionCount);
+      ArraySize finish = partitionBound(i + 1, self.length, partitionCount);
+      Array<T>(self.data + start, finish - start).mapTo(f, Array<U>(result.data + start, finish - start));
     });
 
-    return result; 
+    return owned; 
+  }
+  template<class F> auto mapParallel(F f, unsigned partitionCount, unsigned minToMultithread) const -> OwnedArray<CallResult<F, T>>{
+    return mapParallel<CallResult<F, T>>(f, partitionCount, minToMultithread);
+  }
+
+  //Maps chunks of grainSize elements on the global thread pool as they are claimed (see DynamicPolicy).
+  template<class U, class F> OwnedArray<U> mapParallel(F f, const DynamicPolicy& policy) const {
+    VMATH_INSTRUMENT_SCOPE("mapParallel", length);
+    OwnedArray<U> owned = OwnedArray<U>(length);
+    ArraySize first = 0;
+    ArraySize grain = policy.grainSize;
+    if(grain == 0){
+      first = mapProbe(f, owned.data, grain);
+    }
+    mapChunks(f, owned.data, first, grain);
+    return owned;
+  }
+  template<class F> auto mapParallel(F f, const DynamicPolicy& policy) const -> OwnedArray<CallResult<F, T>>{
+    return mapParallel<CallResult<F, T>>(f, policy);
   }
 
-  template<class U> Array<U> mapParallel(U (*f)(const T)) const {
-    return mapParallel(f, 8, 16); //Defaults
+  //By default the grain is chosen from the cost of f, so cheap maps of small arrays stay on the calling thread and skewed ones are balanced.
+  template<class U, class F> OwnedArray<U> mapParallel(F f) const {
+    return mapParallel<U>(f, DynamicPolicy());
+  }
+  template<class F> auto mapParallel(F f) const -> OwnedArray<CallResult<F, T>>{
+    return mapParallel<CallResult<F, T>>(f);
   }
  
   //For Each
-  void forEach(void (*f)(T&)) {
-    for(unsigned i = 0; i < length; i++){
+  template<class F> void forEach(F f) {
+    for(ArraySize i = 0; i < length; i++){
       f(data[i]);
     }
   }
 
   //Note that not even the closure is const here: this is in keeping with the inherently imperative nature of forEach.
   template<class ClosureTy> void forEach(void (*f)(T&, ClosureTy cl), ClosureTy cl) {
-    for(unsigned i = 0; i < length; i++){
-      f(data[i], cl);
-    }
+    forEach([f, &cl](T& t){f(t, cl);});
   }
   
   ////////////
   //OTHER FUNCTIONAL OPERATORS
   
-  Array<T> filter(bool (*f)(const T t)) const{
-    Array<T> newArr = Array<T>(length);
-    unsigned ni = 0;
-    for(unsigned i = 0; i < length; i++){
-      if((*f)(data[i])){
-        newArr[ni] = data[i];
+  template<typename F> OwnedArray<T> filter(F f) const{
+    OwnedArray<T> newArr = OwnedArray<T>(length);
+    ArraySize ni = 0;
+    for(ArraySize i = 0; i < length; i++){
+      if(f(data[i])){
+        newArr.data[ni] = data[i];
         ni++;
       }
     }
-    newArr.length = ni;
-    //Need a C++ equivalent of this:
-    //newArr.data = (T*)realloc(newArr.data, ni);
+    newArr.length = ni; //The allocation is not shrunk; see filterParallel for an exactly sized result.
     return newArr;
   }
   
-  template<typename Cl> Array<T> filter(bool (*f)(const T t, const Cl), const Cl cl) const{
-    Array<T> newArr = Array<T>(length);
-    unsigned ni = 0;
-    for(unsigned i = 0; i < length; i++){
-      if((*f)(data[i], cl)){
-        newArr[ni++] = data[i];
+  template<typename Cl> OwnedArray<T> filter(bool (*f)(const T t, const Cl), const Cl cl) const{
+    return filter([f, cl](const T t){return f(t, cl);});
+  }
+
+  //The elements whose bits are set in mask (see predicateMask), which has a bit per element.  The result is allocated at exactly the number of set bits.
+  OwnedArray<T> filter(const BitArray& mask) const{
+    VMATH_CHECK_BOUNDS(mask.length == length);
+    OwnedArray<T> newArr = OwnedArray<T>(mask.count());
+    selectBits(newArr.data, data, mask.words.data(), 0, mask.words.size());
+    return newArr;
+  }
+  
+  //Parallel filter: f is evaluated into a mask (see predicateMask), each of partitionCount ranges of the mask counts its set bits, an exclusive scan of the counts gives each range its offset in the output, and the ranges are then compacted concurrently.
+  //The result is allocated at exactly the number of matches.  f is called once per element, from any thread, so it should be pure.
+  template<typename F> OwnedArray<T> filterParallel(F f, unsigned partitionCount, unsigned minToMultithread) const{
+    return filterPartitioned(f, (length < minToMultithread) ? 1 : partitionCount);
+  }
+  template<typename F> OwnedArray<T> filterParallel(F f) const{
+    return filterParallel(f, ThreadPool::global().concurrency(), 1024); //Defaults
+  }
+  template<typename Cl> OwnedArray<T> filterParallel(bool (*f)(const T t, const Cl), const Cl cl, unsigned partitionCount, unsigned minToMultithread) const{
+    return filterParallel([f, cl](const T t){return f(t, cl);}, partitionCount, minToMultithread);
+  }
+  template<typename Cl> OwnedArray<T> filterParallel(bool (*f)(const T t, const Cl), const Cl cl) const{
+    return filterParallel(f, cl, ThreadPool::global().concurrency(), 1024); //Defaults
+  }
+
+  template<typename F> OwnedArray<T> filterPartitioned(F f, unsigned partitionCount) const{
+    VMATH_INSTRUMENT_SCOPE("filterParallel", length);
+    VMATH_CHECK_CONTRACT(partitionCount > 0);
+    const BitArray mask = predicateMaskPartitioned(f, partitionCount);
+    const BitWord* words = mask.words.data();
+    const ArraySize wordCount = mask.words.size();
+    partitionCount = (unsigned)std::min<ArraySize>(partitionCount, wordCount);
+    if(partitionCount == 0) return OwnedArray<T>(0);
+    std::vector<ArraySize> offsets(partitionCount + 1, 0);
+    ArraySize* counts = offsets.data() + 1;
+
+    ThreadPool::global().run(partitionCount, [words, wordCount, partitionCount, counts](unsigned i){
+      ArraySize start = partitionBound(i, wordCount, partitionCount);
+      ArraySize finish = partitionBound(i + 1, wordCount, partitionCount);
+      counts[i] = countBits(words + start, finish - start);
+    });
+
+    //Exclusive scan: offsets[i] becomes the output position of partition i, and offsets[partitionCount] the total.
+    for(unsigned i = 0; i < partitionCount; i++){
+      offsets[i + 1] += offsets[i];
+    }
+
+    OwnedArray<T> owned = OwnedArray<T>(offsets[partitionCount]);
+    const Array<T> result = owned.view();
+    const ArraySize* starts = offsets.data();
+    const T* source = data;
+    ThreadPool::global().run(partitionCount, [source, words, wordCount, partitionCount, starts, result](unsigned i){
+      ArraySize start = partitionBound(i, wordCount, partitionCount);
+      ArraySize finish = partitionBound(i + 1, wordCount, partitionCount);
+      selectBits(result.data + starts[i], source, words, start, finish);
+    });
+    return owned;
+  }
+
+  //Predicate mask helpers
+
+  //The mask of f, with its words split into partitionCount ranges on the global thread pool.  Partitions own whole words, so no two threads write the same word.
+  template<typename F> BitArray predicateMaskPartitioned(F f, unsigned partitionCount) const{
+    BitArray mask(length);
+    BitWord* words = mask.words.data();
+    const ArraySize wordCount = mask.words.size();
+    partitionCount = (unsigned)std::min<ArraySize>(partitionCount, wordCount);
+    const Array<T> self = *this;
+    ThreadPool::global().run(partitionCount, [self, f, words, wordCount, partitionCount](unsigned i){
+      self.predicateWords(f, words, partitionBound(i, wordCount, partitionCount), partitionBound(i + 1, wordCount, partitionCount));
+    });
+    return mask;
+  }
+
+  //Sets words [firstWord, lastWord) of a mask of f.
+  //A word's results are first stored a byte each, a loop the compiler can vectorize, and then packed eight bytes at a time by packFlags.
+  template<typename F> void predicateWords(F f, BitWord* words, ArraySize firstWord, ArraySize lastWord) const{
+    uint8_t flags[BitArray::wordBits];
+    for(ArraySize w = firstWord; w < lastWord; w++){
+      const T* d = data + w * BitArray::wordBits;
+      const unsigned n = (unsigned)std::min<ArraySize>(length - w * BitArray::wordBits, BitArray::wordBits);
+      for(unsigned j = 0; j < n; j++){
+        flags[j] = f(d[j]) ? 1 : 0;
+      }
+      for(unsigned j = n; j < BitArray::wordBits; j++){
+        flags[j] = 0;
       }
+      words[w] = packFlags(flags);
     }
-    newArr.length = ni;
-    return newArr;
   }
   
-  template<typename ResultTy> ResultTy fold(ResultTy (*f)(const ResultTy zero, const T next), ResultTy zero) const{
+  //The accumulator has the type of zero, unless ResultTy is given explicitly.
+  template<typename ResultTy, typename F> ResultTy fold(F f, ResultTy zero) const{
     ResultTy acc = zero;
-    for(unsigned i = 0; i < length; i++){
-      acc = (*f)(acc, data[i]);
+    for(ArraySize i = 0; i < length; i++){
+      acc = f(acc, data[i]);
     }
     return acc;
   }
  
   template<typename ResultTy, typename ClosureTy> ResultTy fold(ResultTy (*f)(const ResultTy zero, const T next, const ClosureTy closure), const ResultTy zero, const ClosureTy cl) const{
-    ResultTy acc = zero;
-    for(unsigned i = 0; i < length; i++){
-      acc = (*f)(acc, data[i], cl);
+    return fold<ResultTy>([f, cl](const ResultTy acc, const T next){return f(acc, next, cl);}, zero);
+  }
+
+  //Given an associative function f and its identity zero, folds each of partitionCount ranges on the global thread pool, then joins the partial results in order with combine.
+  //combine(zero, r) must equal r, and combine must be associative; the fold f need only agree with combine (f(acc, t) == combine(acc, f(zero, t))).
+  template<typename ResultTy, typename F, typename C> ResultTy foldParallel(F f, C combine, const ResultTy zero, unsigned partitionCount, unsigned minToMultithread) const{
+    VMATH_INSTRUMENT_SCOPE("foldParallel", length);
+    if(length < minToMultithread || partitionCount < 2){
+      return fold<ResultTy>(f, zero);
     }
-    return acc;
+    std::vector<ResultTy> partials(partitionCount, zero);
+    ResultTy* out = partials.data();
+    const Array<T> self = *this;
+    ThreadPool::global().run(partitionCount, [self, f, zero, partitionCount, out](unsigned i){
+      ArraySize start = partitionBound(i, self.length, partitionCount);
+      ArraySize finish = partitionBound(i + 1, self.length, partitionCount);
+      out[i] = Array<T>(self.data + start, finish - start).template fold<ResultTy>(f, zero);
+    });
+    return Array<ResultTy>::treeReduce(combine, out, partitionCount);
+  }
+  template<typename ResultTy, typename F, typename C> ResultTy foldParallel(F f, C combine, const ResultTy zero) const{
+    return foldParallel<ResultTy>(f, combine, zero, ThreadPool::global().concurrency(), 1024); //Defaults
   }
 
   //Given a commutative function f, fold a list of A into a single A.
-  T foldUnordered(T (*f)(const T t0, const T t1)) const{
-    assert(length > 0);
-    if(length == 1) return data[0];
-    else{
-      assert(f(data[0], data[1]) == f(data[1], data[0])); //Assert commutativity (this check is necessary but not sufficient).
-      return f(data[0], tail().foldUnordered(f));
-    }
+  //The fold is a balanced tree over the array, so it uses O(log(length)) stack.
+  template<typename F> T foldUnordered(F f) const{
+    VMATH_CHECK_CONTRACT(length > 0);
+    VMATH_CHECK_CONTRACT(length == 1 || f(data[0], data[1]) == f(data[1], data[0])); //Assert commutativity (this check is necessary but not sufficient).
+    return treeReduce(f, data, length);
   }
   template<typename Closure> T foldUnordered(T (*f)(const T t0, const T t1, const Closure cl), const Closure cl) const{
-    assert(length > 0);
-    if(length == 1) return data[0];
-    else{
-      assert(f(data[0], data[1], cl) == f(data[1], data[0], cl)); //Assert commutativity (this check is necessary but not sufficient).
-      return f(data[0], tail().foldUnordered(f));
+    return foldUnordered([f, cl](const T t0, const T t1){return f(t0, t1, cl);});
+  }
+
+  //As foldUnordered, with the subtrees over each of partitionCount ranges folded on the global thread pool.
+  template<typename F> T foldUnorderedParallel(F f, unsigned partitionCount, unsigned minToMultithread) const{
+    VMATH_CHECK_CONTRACT(length > 0);
+    VMATH_CHECK_CONTRACT(length == 1 || f(data[0], data[1]) == f(data[1], data[0])); //Assert commutativity (this check is necessary but not sufficient).
+    return treeReduceParallel(f, partitionCount, minToMultithread);
+  }
+  template<typename F> T foldUnorderedParallel(F f) const{
+    return foldUnorderedParallel(f, ThreadPool::global().concurrency(), 1024); //Defaults
+  }
+  template<typename Closure> T foldUnorderedParallel(T (*f)(const T t0, const T t1, const Closure cl), const Closure cl, unsigned partitionCount, unsigned minToMultithread) const{
+    return foldUnorderedParallel([f, cl](const T t0, const T t1){return f(t0, t1, cl);}, partitionCount, minToMultithread);
+  }
+  template<typename Closure> T foldUnorderedParallel(T (*f)(const T t0, const T t1, const Closure cl), const Closure cl) const{
+    return foldUnorderedParallel(f, cl, ThreadPool::global().concurrency(), 1024); //Defaults
+  }
+
+  //Reduction helpers
+
+  //Start of partition i when length elements are split into partitionCount nearly equal ranges.
+  //Computed as i * (length / partitionCount) + i * (length % partitionCount) / partitionCount, which equals i * length / partitionCount but never forms a product wider than i * partitionCount, so it can't overflow at any length.
+  static ArraySize partitionBound(unsigned i, ArraySize length, unsigned partitionCount){
+    return i * (length / partitionCount) + (ArraySize)((uint64_t)i * (length % partitionCount) / partitionCount);
+  }
+
+  //Scheduling helpers for mapParallel
+
+  //Maps elements from the start into out serially, in doubling runs, until they are done or have taken MAP_PROBE_NANOSECONDS.  Returns the number mapped, and sets grain for the rest from the time they took.
+  template<class U, class F> ArraySize mapProbe(F& f, U* out, ArraySize& grain) const {
+    const unsigned threads = ThreadPool::global().concurrency();
+    if(threads < 2){
+      Array<T>(data, length).mapTo(f, Array<U>(out, length));
+      return length;
+    }
+    typedef std::chrono::steady_clock Clock;
+    const Clock::time_point start = Clock::now();
+    ArraySize done = 0;
+    long long elapsed = 0;
+    for(ArraySize run = 1; done < length && elapsed < MAP_PROBE_NANOSECONDS; run = std::min<ArraySize>(2 * run, 1u << 30)){
+      ArraySize n = std::min(run, length - done);
+      Array<T>(data + done, n).mapTo(f, Array<U>(out + done, n));
+      done += n;
+      elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+    }
+    if(done == length) return done;
+    double perElement = (double)elapsed / done;
+    ArraySize balanced = (length - done) / (threads * MAP_CHUNKS_PER_THREAD);
+    double amortized = MAP_CHUNK_NANOSECONDS / perElement;
+    grain = (amortized < balanced) ? (ArraySize)amortized : balanced;
+    if(grain == 0) grain = 1;
+    return done;
+  }
+
+  //Maps elements [first, length) into out in chunks of grain elements on the global thread pool.
+  template<class U, class F> void mapChunks(F& f, U* out, ArraySize first, ArraySize grain) const {
+    if(first >= length) return;
+    ArraySize remaining = length - first;
+    if(remaining / grain >= (1u << 30)) grain = remaining / (1u << 30) + 1; //Task counts are unsigned.
+    unsigned chunkCount = (unsigned)(remaining / grain + (remaining % grain != 0));
+    const Array<T> self = *this;
+    ThreadPool::global().run(chunkCount, [self, &f, out, first, grain](unsigned c){
+      ArraySize start = first + c * grain;
+      ArraySize n = std::min(grain, self.length - start);
+      Array<T>(self.data + start, n).mapTo(f, Array<U>(out + start, n));
+    });
+  }
+
+  //Sorting helpers
+
+  //Merges sorted a and b into out (stably, as std::merge does), split into up to partitionCount pieces on the global thread pool.
+  static void mergeParallel(const T* a, ArraySize aLength, const T* b, ArraySize bLength, T* out, unsigned partitionCount){
+    ArraySize total = aLength + bLength;
+    if(partitionCount > total) partitionCount = total;
+    ThreadPool::global().run(partitionCount, [=](unsigned i){
+      ArraySize d0 = partitionBound(i, total, partitionCount);
+      ArraySize d1 = partitionBound(i + 1, total, partitionCount);
+      ArraySize a0 = mergeSplit(a, aLength, b, bLength, d0);
+      ArraySize a1 = mergeSplit(a, aLength, b, bLength, d1);
+      std::merge(a + a0, a + a1, b + (d0 - a0), b + (d1 - a1), out + d0);
+    });
+  }
+
+  //The number of elements of a among the first d elements of the stable merge of a and b.
+  static ArraySize mergeSplit(const T* a, ArraySize aLength, const T* b, ArraySize bLength, ArraySize d){
+    ArraySize lo = (d > bLength) ? d - bLength : 0;
+    ArraySize hi = std::min(d, aLength);
+    while(lo < hi){
+      ArraySize mid = lo + (hi - lo) / 2;
+      if(b[d - mid - 1] < a[mid]) hi = mid;
+      else lo = mid + 1;
+    }
+    return lo;
+  }
+
+  //Counts the digits of passes [firstPass, lastPass) of the keys in each of partitionCount ranges of d, into counts as laid out in radixSort.
+  void countRadixDigits(const T* d, ArraySize* counts, unsigned partitionCount, unsigned firstPass, unsigned lastPass) const {
+    const unsigned passCount = sizeof(typename RadixKey<T>::type);
+    ArraySize len = length;
+    ThreadPool::global().run(partitionCount, [d, counts, len, partitionCount, firstPass, lastPass, passCount](unsigned p){
+      ArraySize* c = counts + (size_t)p * passCount * 256;
+      std::fill(c + firstPass * 256, c + lastPass * 256, 0u);
+      ArraySize last = partitionBound(p + 1, len, partitionCount);
+      for(ArraySize i = partitionBound(p, len, partitionCount); i < last; i++){
+        typename RadixKey<T>::type key = RadixKey<T>::get(d[i]);
+        for(unsigned pass = firstPass; pass < lastPass; pass++){
+          c[pass * 256 + ((key >> (8 * pass)) & 255)]++;
+        }
+      }
+    });
+  }
+
+  //Shuffling helpers
+
+  //Seed of random stream i of a shuffle, from the splitmix64 sequence starting at seed.
+  static uint64_t shuffleStreamSeed(uint64_t seed, unsigned i){
+    uint64_t z = seed + (i + 1) * 0x9e3779b97f4a7c15ull;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+  }
+
+  //Uniform in [0, range), by scaling a random draw with a multiplication and rejecting the few draws that would bias it (Lemire's method).
+  //Ranges that fit in 32 bits scale a 32 bit draw, so shuffles of arrays under 2^32 elements are the same whatever ArraySize is; larger ranges scale a 64 bit draw.
+  static ArraySize randomBelow(std::mt19937_64& r, ArraySize range){
+    if((uint64_t)range <= 0xffffffffull){
+      uint32_t range32 = (uint32_t)range;
+      uint64_t m = (r() >> 32) * range32;
+      if((uint32_t)m < range32){
+        uint32_t threshold = (0 - range32) % range32;
+        while((uint32_t)m < threshold){
+          m = (r() >> 32) * range32;
+        }
+      }
+      return m >> 32;
+    }
+    uint64_t high;
+    uint64_t low = multiplyWide(r(), range, high);
+    if(low < (uint64_t)range){
+      uint64_t threshold = (0 - (uint64_t)range) % (uint64_t)range;
+      while(low < threshold){
+        low = multiplyWide(r(), range, high);
+      }
     }
+    return (ArraySize)high;
+  }
+
+  //Fisher-Yates shuffle.
+  static void shuffleRange(T* d, ArraySize len, std::mt19937_64& r){
+    for(ArraySize i = len; i > 1; i--){
+      std::swap(d[i - 1], d[randomBelow(r, i)]);
+    }
+  }
+
+  //Reduces a nonempty range with f.  Ranges of up to treeLeafSize are folded left to right, larger ones are split in half.
+  static const unsigned treeLeafSize = 64;
+  template<typename F> static T treeReduce(F f, const T* d, ArraySize len){
+    VMATH_CHECK_CONTRACT(len > 0);
+    if(len <= treeLeafSize){
+      T acc = d[0];
+      for(ArraySize i = 1; i < len; i++){
+        acc = f(acc, d[i]);
+      }
+      return acc;
+    }
+    ArraySize half = len / 2;
+    return f(treeReduce(f, d, half), treeReduce(f, d + half, len - half));
+  }
+
+  template<typename F> T treeReduceParallel(F f, unsigned partitionCount, unsigned minToMultithread) const{
+    VMATH_INSTRUMENT_SCOPE("foldUnorderedParallel", length);
+    VMATH_CHECK_CONTRACT(length > 0);
+    if(partitionCount > length) partitionCount = length; //Every partition must be nonempty.
+    if(length < minToMultithread || partitionCount < 2){
+      return treeReduce(f, data, length);
+    }
+    std::vector<T> partials(partitionCount, data[0]);
+    T* out = partials.data();
+    const Array<T> self = *this;
+    ThreadPool::global().run(partitionCount, [self, f, partitionCount, out](unsigned i){
+      ArraySize start = partitionBound(i, self.length, partitionCount);
+      ArraySize finish = partitionBound(i + 1, self.length, partitionCount);
+      out[i] = treeReduce(f, self.data + start, finish - start);
+    });
+    return treeReduce(f, out, partitionCount);
   }
   
   //Zip
   
-  template<typename OtherTy, typename ResTy> Array<ResTy> zip(const Array<OtherTy> other, ResTy (*f)(const T, const OtherTy)) const {
+  //As with map, the result type may be given explicitly (zip<OtherTy, ResTy>(other, f)), otherwise it is the type f returns.
+  template<typename OtherTy, typename ResTy, typename F> OwnedArray<ResTy> zip(const Array<OtherTy> other, F f) const {
 
-    assert(length == other.length);
+    VMATH_CHECK_BOUNDS(length == other.length);
     
-    Array<ResTy> result = Array<ResTy>(length);
-    for(unsigned i = 0; i < length; i++){
-      result[i] = f(data[i], other[i]);
+    OwnedArray<ResTy> result = OwnedArray<ResTy>(length);
+    ResTy* r = result.data;
+    const OtherTy* o = other.data;
+    for(ArraySize i = 0; i < length; i++){
+      r[i] = f(data[i], o[i]);
     }
     
     return result;
   }
+  template<typename OtherTy, typename F> auto zip(const Array<OtherTy> other, F f) const -> OwnedArray<CallResult<F, T, OtherTy>> {
+    return zip<OtherTy, CallResult<F, T, OtherTy>>(other, f);
+  }
   
-  template<typename OtherTy, typename ResTy, typename ClosureTy> Array<ResTy> zip(const Array<OtherTy> other, ResTy (*f)(const T, const OtherTy, const ClosureTy), const ClosureTy cl) const {
+  template<typename OtherTy, typename ResTy, typename ClosureTy> OwnedArray<ResTy> zip(const Array<OtherTy> other, ResTy (*f)(const T, const OtherTy, const ClosureTy), const ClosureTy cl) const {
+    return zip<OtherTy, ResTy>(other, [f, cl](const T t, const OtherTy o){return f(t, o, cl);});
+  }
 
-    assert(length == other.length);
-    
-    Array<ResTy> result = Array<ResTy>(length);
-    for(unsigned i = 0; i < length; i++){
-      result[i] = f(data[i], other[i], cl);
+};
+
+//An Array that owns its memory and frees it on destruction.
+//It is an Array, so it can be passed wherever an Array view is accepted, and operations that allocate (map, filter, zip and so on) return one.
+//It can be moved but not copied; use clone for a deep copy, view for a non-owning Array, and release to give up ownership.
+//Don't call freeMemory through an Array view of an OwnedArray.
+//Memory comes from the thread's current ArrayAllocator (see allocator.hpp) when one is set, and from new [] otherwise.
+template <typename T> struct OwnedArray : Array<T> {
+  ArrayAllocator* allocator; //nullptr when the memory is from new [].
+  ArraySize capacity;         //Elements allocated, which may exceed length after a filter.
+
+  OwnedArray() : Array<T>(0, (T*)nullptr), allocator(nullptr), capacity(0) { }
+
+  //Empty array (Warning: No initialization)
+  explicit OwnedArray(ArraySize length) : OwnedArray(length, currentArrayAllocator(), AllocateTag()) { }
+
+  //Allocates from the given allocator rather than the current one.
+  OwnedArray(ArraySize length, ArrayAllocator& allocator) : OwnedArray(length, &allocator, AllocateTag()) { }
+
+  //Initialize array to value
+  OwnedArray(ArraySize length, T val) : OwnedArray(length) {
+    std::fill(this->data, this->data + length, val);
+  }
+
+  //Takes ownership of memory allocated with new [].
+  static OwnedArray<T> adopt(const Array<T> arr){
+    OwnedArray<T> owned;
+    owned.length = owned.capacity = arr.length;
+    owned.data = arr.data;
+    return owned;
+  }
+
+  OwnedArray(OwnedArray<T>&& other) : Array<T>(other.length, other.data), allocator(other.allocator), capacity(other.capacity) {
+    other.forget();
+  }
+
+  OwnedArray<T>& operator=(OwnedArray<T>&& other){
+    if(this != &other){
+      freeMemory();
+      this->length = other.length;
+      this->data = other.data;
+      allocator = other.allocator;
+      capacity = other.capacity;
+      other.forget();
     }
-    
-    return result;
+    return *this;
+  }
+
+  OwnedArray(const OwnedArray<T>&) = delete;
+  OwnedArray<T>& operator=(const OwnedArray<T>&) = delete;
+
+  ~OwnedArray(){
+    freeMemory();
+  }
+
+  Array<T> view() const {
+    return Array<T>(this->length, this->data);
+  }
+
+  //Gives up ownership; the caller becomes responsible for calling freeMemory on the result.
+  //Memory from an ArrayAllocator can't be freed that way, so in that case the contents are first moved to memory from new [].
+  Array<T> release(){
+    if(allocator != nullptr){
+      OwnedArray<T> moved = OwnedArray<T>(this->length, nullptr, AllocateTag());
+      std::move(this->data, this->data + this->length, moved.data);
+      freeMemory();
+      return moved.release();
+    }
+    Array<T> arr = view();
+    forget();
+    return arr;
   }
 
+  OwnedArray<T> clone() const {
+    OwnedArray<T> copy = OwnedArray<T>(this->length);
+    std::copy(this->data, this->data + this->length, copy.data);
+    return copy;
+  }
+
+  void freeMemory(){
+    if(allocator == nullptr){
+      delete [] this->data;
+    }
+    else if(this->data != nullptr){
+      for(ArraySize i = 0; i < capacity; i++){
+        this->data[i].~T();
+      }
+      allocator->deallocate(this->data, (size_t)capacity * sizeof(T), alignof(T));
+    }
+    forget();
+  }
+
+private:
+  struct AllocateTag { };
+
+  OwnedArray(ArraySize length, ArrayAllocator* allocator, AllocateTag) : allocator(allocator), capacity(length) {
+    this->length = length;
+    if(allocator == nullptr){
+      this->data = new T[length];
+    }
+    else{
+      this->data = (T*)allocator->allocate((size_t)length * sizeof(T), alignof(T));
+      for(ArraySize i = 0; i < length; i++){
+        new (this->data + i) T;
+      }
+    }
+  }
+
+  void forget(){
+    this->data = nullptr;
+    this->length = 0;
+    capacity = 0;
+    allocator = nullptr;
+  }
 };
 
+template <typename T> Array<T>::Array(OwnedArray<T>&& owned) : Array(owned.release()) { }
+
 template <typename T> std::ostream& operator<<(std::ostream& o, const Array<T>& arr){
   arr.writeToStream(o);
   return o;
@@ -353,12 +1299,8 @@ template <typename T> Array<T> tail(const Array<T> arr){
 	return arr.tail();
 }
 
-template <typename T> Array<T> slice(Array<T> arr, unsigned s, unsigned e){
+template <typename T> Array<T> slice(Array<T> arr, ArraySize s, ArraySize e){
 	return arr.slice(s, e);
 }
 
-
-//Due to a very interesting design decision, vector<bool> is implemented as a bit array.
-typedef std::vector<bool> BitArray;
-
 #endif
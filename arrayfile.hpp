@@ -0,0 +1,180 @@
+//Binary array files
+//A versioned on-disk format for Arrays of plain numeric types, written by writeArrayFile and mapped back into memory by MappedArray without copying or parsing.
+
+//Layout: an ArrayFileHeader, padding up to dataOffset, then length elements in native byte order.
+//dataOffset is a multiple of the recorded alignment (at least 64 bytes), so the elements of a mapped file are suitably aligned for any SIMD width.
+//Mapping uses POSIX mmap.
+
+#ifndef ARRAYFILE_H
+#define ARRAYFILE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <type_traits>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "array.hpp"
+
+#define ARRAY_FILE_VERSION 1
+#define ARRAY_FILE_ALIGNMENT 64
+#define ARRAY_FILE_BYTE_ORDER 0x01020304u
+
+//Element type codes stored in the header.  Only the types with a code can be written or mapped.
+enum ArrayFileType : uint32_t {
+  ARRAY_FILE_INT8 = 1, ARRAY_FILE_UINT8, ARRAY_FILE_INT16, ARRAY_FILE_UINT16, ARRAY_FILE_INT32, ARRAY_FILE_UINT32, ARRAY_FILE_INT64, ARRAY_FILE_UINT64,
+  ARRAY_FILE_FLOAT, ARRAY_FILE_DOUBLE
+};
+
+//Types are coded by their size and signedness rather than their identity, so char, long, long long and the rest share the code of the fixed width type with the same representation.
+template<typename T, typename Enable = void> struct ArrayFileTypeOf;
+template<typename T> struct ArrayFileTypeOf<T, typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value && (sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8)>::type> {
+  static const uint32_t code = ARRAY_FILE_INT8 + 2 * (sizeof(T) == 1 ? 0 : sizeof(T) == 2 ? 1 : sizeof(T) == 4 ? 2 : 3) + (std::is_unsigned<T>::value ? 1 : 0);
+};
+template<typename T> struct ArrayFileTypeOf<T, typename std::enable_if<std::is_floating_point<T>::value && (sizeof(T) == 4 || sizeof(T) == 8)>::type> {
+  static const uint32_t code = (sizeof(T) == 4) ? ARRAY_FILE_FLOAT : ARRAY_FILE_DOUBLE;
+};
+
+struct ArrayFileHeader {
+  char magic[8];      //"VMARRAY" and a terminating zero.
+  uint32_t version;
+  uint32_t byteOrder; //ARRAY_FILE_BYTE_ORDER as written by the producing machine.
+  uint32_t elementType;
+  uint32_t elementSize;
+  uint32_t alignment;
+  uint32_t reserved;
+  uint64_t length;
+  uint64_t dataOffset;
+};
+
+//Whether header describes a well formed file of fileSize bytes holding elements of type T.
+template<typename T> bool validArrayFileHeader(const ArrayFileHeader& header, uint64_t fileSize){
+  if(memcmp(header.magic, "VMARRAY", 8) != 0) return false;
+  if(header.version != ARRAY_FILE_VERSION || header.byteOrder != ARRAY_FILE_BYTE_ORDER) return false;
+  if(header.elementType != ArrayFileTypeOf<T>::code || header.elementSize != sizeof(T)) return false;
+  if(header.alignment < alignof(T) || header.dataOffset < sizeof(ArrayFileHeader) || header.dataOffset % header.alignment != 0) return false;
+  if(header.length > (uint64_t)(ArraySize)-1 || header.dataOffset > fileSize) return false;
+  return header.length <= (fileSize - header.dataOffset) / sizeof(T);
+}
+
+//Writes arr to the file at path in the format above, replacing any existing file.  Returns false if the file could not be written.
+template<typename T> bool writeArrayFile(const char* path, const Array<T> arr){
+  ArrayFileHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, "VMARRAY", 8);
+  header.version = ARRAY_FILE_VERSION;
+  header.byteOrder = ARRAY_FILE_BYTE_ORDER;
+  header.elementType = ArrayFileTypeOf<T>::code;
+  header.elementSize = sizeof(T);
+  header.alignment = ARRAY_FILE_ALIGNMENT;
+  header.length = arr.length;
+  header.dataOffset = ARRAY_FILE_ALIGNMENT;
+  static_assert(sizeof(ArrayFileHeader) <= ARRAY_FILE_ALIGNMENT, "The header must fit before the data.");
+
+  FILE* f = fopen(path, "wb");
+  if(f == nullptr) return false;
+  char block[ARRAY_FILE_ALIGNMENT] = {};
+  memcpy(block, &header, sizeof(header));
+  bool ok = fwrite(block, 1, sizeof(block), f) == sizeof(block);
+  ok = ok && fwrite(arr.data, sizeof(T), arr.length, f) == arr.length;
+  ok = (fclose(f) == 0) && ok;
+  return ok;
+}
+
+enum ArrayMapMode {
+  MAP_READ_ONLY,    //Writing to the elements is an error (the process will be sent SIGSEGV).
+  MAP_COPY_ON_WRITE //Writes are private to this mapping and never reach the file.
+};
+
+//An Array whose elements are mapped from a file written by writeArrayFile.  Pages are read in on first access, so opening costs the same regardless of the file's size.
+//Like OwnedArray, a MappedArray can be moved but not copied, and unmaps the file when destroyed; Arrays taken from it are views that must not outlive it.
+//If the file can't be opened or isn't a valid file of Ts, the result is empty and isOpen returns false.
+template <typename T> struct MappedArray : Array<T> {
+  void* mapping;
+  size_t mappingSize;
+
+  MappedArray() : Array<T>(0, (T*)nullptr), mapping(nullptr), mappingSize(0) { }
+
+  explicit MappedArray(const char* path, ArrayMapMode mode = MAP_READ_ONLY) : MappedArray() {
+    int fd = open(path, O_RDONLY);
+    if(fd < 0) return;
+    struct stat st;
+    if(fstat(fd, &st) == 0 && (uint64_t)st.st_size >= sizeof(ArrayFileHeader)){
+      int prot = (mode == MAP_READ_ONLY) ? PROT_READ : (PROT_READ | PROT_WRITE);
+      void* p = mmap(nullptr, st.st_size, prot, MAP_PRIVATE, fd, 0);
+      if(p != MAP_FAILED){
+        const ArrayFileHeader& header = *(const ArrayFileHeader*)p;
+        if(validArrayFileHeader<T>(header, st.st_size)){
+          mapping = p;
+          mappingSize = st.st_size;
+          this->length = header.length;
+          this->data = (T*)((char*)p + header.dataOffset);
+        }
+        else{
+          munmap(p, st.st_size);
+        }
+      }
+    }
+    close(fd); //The mapping keeps the file open.
+  }
+
+  MappedArray(MappedArray<T>&& other) : Array<T>(other.length, other.data), mapping(other.mapping), mappingSize(other.mappingSize) {
+    other.forget();
+  }
+  MappedArray<T>& operator=(MappedArray<T>&& other){
+    if(this != &other){
+      unmap();
+      this->length = other.length;
+      this->data = other.data;
+      mapping = other.mapping;
+      mappingSize = other.mappingSize;
+      other.forget();
+    }
+    return *this;
+  }
+
+  MappedArray(const MappedArray<T>&) = delete;
+  MappedArray<T>& operator=(const MappedArray<T>&) = delete;
+
+  ~MappedArray(){
+    unmap();
+  }
+
+  bool isOpen() const {
+    return mapping != nullptr;
+  }
+
+  Array<T> view() const {
+    return Array<T>(this->length, this->data);
+  }
+
+  //Copies the elements into an OwnedArray, which stays valid after the file is unmapped.
+  OwnedArray<T> clone() const {
+    OwnedArray<T> copy = OwnedArray<T>(this->length);
+    std::copy(this->data, this->data + this->length, copy.data);
+    return copy;
+  }
+
+  void unmap(){
+    if(mapping != nullptr) munmap(mapping, mappingSize);
+    forget();
+  }
+
+  //Mapped memory isn't freed with delete [], so this hides Array::freeMemory.
+  void freeMemory(){
+    unmap();
+  }
+
+private:
+  void forget(){
+    this->data = nullptr;
+    this->length = 0;
+    mapping = nullptr;
+    mappingSize = 0;
+  }
+};
+
+#endif
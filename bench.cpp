@@ -0,0 +1,266 @@
+//Benchmarks
+//Times the hot paths of array.hpp and vectormath.hpp and prints the results as JSON, for comparing builds and library versions.
+
+//Usage: BENCH [--quick] [--only name]
+//--quick runs shorter trials on smaller arrays, and --only runs just the benchmarks whose names contain name.
+//Each result records the array size, thread count, the best time per element over several trials, the bytes streamed per second, and for thread sweeps the scaling efficiency (time on one thread / (threads * time on this many threads)).
+
+#include <iostream>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <random>
+#include <string.h>
+#include "array.hpp"
+#include "vectormath.hpp"
+
+struct BenchResult {
+  std::string name;
+  std::string variant;
+  unsigned long long elements;
+  unsigned threads;
+  double nsPerElement;
+  double gbPerSecond;
+  double scalingEfficiency; //Negative when not part of a thread sweep.
+};
+
+struct BenchConfig {
+  bool quick = false;
+  const char* only = nullptr;
+  double minTrialSeconds = 0.05;
+  unsigned trials = 5;
+};
+
+static BenchConfig config;
+static std::vector<BenchResult> results;
+
+//Makes t, and everything reachable through memory, appear used, so the work that produced it can't be optimized away or hoisted out of the timing loop.
+template<typename T> void keep(const T& t){
+  asm volatile("" : : "r"(&t) : "memory");
+}
+
+//Best seconds per call of f over the trials, each trial repeating f until it has run for minTrialSeconds.
+template<typename F> double timeCall(F f){
+  typedef std::chrono::steady_clock Clock;
+  double best = 1e300;
+  for(unsigned t = 0; t < config.trials; t++){
+    unsigned reps = 0;
+    Clock::time_point start = Clock::now();
+    double elapsed = 0;
+    do{
+      f();
+      reps++;
+      elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    } while(elapsed < config.minTrialSeconds);
+    best = std::min(best, elapsed / reps);
+  }
+  return best;
+}
+
+bool selected(const char* name){
+  return config.only == nullptr || strstr(name, config.only) != nullptr;
+}
+
+//Times f, which processes elements elements and streams bytes bytes, records it, and returns the seconds per call.
+template<typename F> double bench(const char* name, const std::string& variant, unsigned long long elements, double bytes, F f, unsigned threads = 1, double singleThreadSeconds = -1){
+  double seconds = timeCall(f);
+  BenchResult r;
+  r.name = name;
+  r.variant = variant;
+  r.elements = elements;
+  r.threads = threads;
+  r.nsPerElement = seconds * 1e9 / elements;
+  r.gbPerSecond = bytes / seconds / 1e9;
+  r.scalingEfficiency = (singleThreadSeconds > 0) ? singleThreadSeconds / (threads * seconds) : -1;
+  results.push_back(r);
+  std::cerr << name << " " << variant << " n=" << elements << " t=" << threads << ": " << r.nsPerElement << " ns/element" << std::endl;
+  return seconds;
+}
+
+//Fills a new array with uniform values in [lo, hi).
+template<typename T> OwnedArray<T> randomArray(unsigned n, double lo, double hi, unsigned seed){
+  std::mt19937 gen(seed);
+  std::uniform_real_distribution<double> dist(lo, hi);
+  OwnedArray<T> arr = OwnedArray<T>(n);
+  for(unsigned i = 0; i < n; i++){
+    arr[i] = (T)dist(gen);
+  }
+  return arr;
+}
+
+std::vector<unsigned> sizes(){
+  if(config.quick) return {1 << 10, 1 << 16, 1 << 20};
+  return {1 << 10, 1 << 16, 1 << 20, 1 << 24};
+}
+
+//Thread counts 1, 2, 4, ... up to and including the hardware's.
+std::vector<unsigned> threadCounts(){
+  unsigned hw = std::max(1u, std::thread::hardware_concurrency());
+  std::vector<unsigned> counts;
+  for(unsigned t = 1; t < hw; t *= 2){
+    counts.push_back(t);
+  }
+  counts.push_back(hw);
+  return counts;
+}
+
+void benchMap(){
+  if(!selected("map")) return;
+  for(unsigned n : sizes()){
+    OwnedArray<float> a = randomArray<float>(n, -1, 1, 1);
+    OwnedArray<float> out = OwnedArray<float>(n);
+    bench("map", "affine", n, 8.0 * n, [&](){a.mapTo([](float x){return 3 * x + 1;}, out.view()); keep(out[0]);});
+  }
+}
+
+void benchMapParallel(){
+  if(!selected("mapParallel")) return;
+  unsigned original = ThreadPool::global().workerCount();
+  for(unsigned n : sizes()){
+    OwnedArray<float> a = randomArray<float>(n, 0, 100, 2);
+    double single[2] = {-1, -1};
+    for(unsigned t : threadCounts()){
+      ThreadPool::global().resize(t - 1);
+      double cheap = bench("mapParallel", "static", n, 8.0 * n, [&](){keep(a.mapParallel([](float x){return sqrtf(x) + 1;}, t, 0)[0]);}, t, single[0]);
+      double costly = bench("mapParallel", "dynamic-costly", n, 8.0 * n, [&](){keep(a.mapParallel([](float x){float y = x; for(int k = 0; k < 32; k++) y = sqrtf(y + x); return y;})[0]);}, t, single[1]);
+      if(t == 1){
+        single[0] = cheap;
+        single[1] = costly;
+      }
+    }
+  }
+  ThreadPool::global().resize(original);
+}
+
+void benchFilter(){
+  if(!selected("filter")) return;
+  double selectivities[3] = {0.01, 0.5, 0.99};
+  for(unsigned n : sizes()){
+    OwnedArray<float> a = randomArray<float>(n, 0, 1, 3);
+    for(double s : selectivities){
+      float cut = (float)s;
+      std::string pct = std::to_string((int)(s * 100)) + "%";
+      bench("filter", "selectivity " + pct, n, 4.0 * n * (1 + s), [&](){keep(a.filter([cut](float x){return x < cut;}).length);});
+      bench("filterParallel", "selectivity " + pct, n, 4.0 * n * (1 + s), [&](){keep(a.filterParallel([cut](float x){return x < cut;}).length);}, ThreadPool::global().concurrency());
+      BitArray mask = a.predicateMask([cut](float x){return x < cut;});
+      bench("filter", "mask selectivity " + pct, n, 4.0 * n * s + n / 8.0, [&](){keep(a.filter(mask).length);});
+    }
+  }
+}
+
+void benchBitArray(){
+  if(!selected("predicateMask") && !selected("bitArray")) return;
+  for(unsigned n : sizes()){
+    OwnedArray<float> a = randomArray<float>(n, 0, 1, 9);
+    if(selected("predicateMask")) bench("predicateMask", "x < 0.5", n, 4.0 * n + n / 8.0, [&](){keep(a.predicateMask([](float x){return x < 0.5f;}).words[0]);});
+    BitArray m0 = a.predicateMask([](float x){return x < 0.5f;}), m1 = a.predicateMask([](float x){return x > 0.25f;});
+    if(selected("bitArray")) bench("bitArray", "and", n, 3 * n / 8.0, [&](){keep((m0 & m1).words[0]);});
+    if(selected("bitArray")) bench("bitArray", "count", n, n / 8.0, [&](){keep(m0.count());});
+  }
+}
+
+void benchFold(){
+  if(!selected("fold")) return;
+  for(unsigned n : sizes()){
+    OwnedArray<double> a = randomArray<double>(n, -1, 1, 4);
+    bench("fold", "sum", n, 8.0 * n, [&](){keep(a.fold<double>([](double acc, double x){return acc + x;}, 0));});
+    bench("foldUnordered", "sum", n, 8.0 * n, [&](){keep(a.foldUnordered([](double x, double y){return x + y;}));});
+    bench("foldUnorderedParallel", "sum", n, 8.0 * n, [&](){keep(a.foldUnorderedParallel([](double x, double y){return x + y;}));}, ThreadPool::global().concurrency());
+  }
+}
+
+void benchSort(){
+  if(!selected("sort")) return;
+  for(unsigned n : sizes()){
+    OwnedArray<int> source = OwnedArray<int>(n);
+    std::mt19937 gen(5);
+    for(unsigned i = 0; i < n; i++){
+      source[i] = (int)gen();
+    }
+    OwnedArray<int> work = OwnedArray<int>(n);
+    //Each call re-copies the unsorted input; the copy is counted in the time, as it is small beside the sort.
+    bench("sort", "std::sort", n, 8.0 * n, [&](){std::copy(source.data, source.data + n, work.data); work.sort(); keep(work[0]);});
+    bench("sort", "parallel merge", n, 8.0 * n, [&](){std::copy(source.data, source.data + n, work.data); work.sort(ParallelPolicy()); keep(work[0]);}, ThreadPool::global().concurrency());
+    bench("radixSort", "serial", n, 8.0 * n, [&](){std::copy(source.data, source.data + n, work.data); work.radixSort(); keep(work[0]);});
+    bench("radixSort", "parallel", n, 8.0 * n, [&](){std::copy(source.data, source.data + n, work.data); work.radixSort(ParallelPolicy()); keep(work[0]);}, ThreadPool::global().concurrency());
+  }
+}
+
+void benchVectormath(){
+  for(unsigned n : sizes()){
+    OwnedArray<float> a = randomArray<float>(n, -1, 1, 6), b = randomArray<float>(n, -1, 1, 7);
+    OwnedArray<double> p = randomArray<double>(n, 0, 1, 8);
+    scalarMultiplyInPlace(p.view(), 1 / sumTerms(p.view(), VectorizedPolicy()));
+    if(selected("distanceSquared")) bench("distanceSquared", "float", n, 8.0 * n, [&](){keep(distanceSquared(a.view(), b.view()));});
+    if(selected("dotProduct")) bench("dotProduct", "float", n, 8.0 * n, [&](){keep(dotProduct(a.view(), b.view()));});
+    if(selected("sumTerms")) bench("sumTerms", "float sequential", n, 4.0 * n, [&](){keep(sumTerms(a.view(), SequentialPolicy()));});
+    if(selected("sumTerms")) bench("sumTerms", "float vectorized", n, 4.0 * n, [&](){keep(sumTerms(a.view(), VectorizedPolicy()));});
+    if(selected("l1Norm")) bench("l1Norm", "float vectorized", n, 4.0 * n, [&](){keep(l1Norm(a.view(), VectorizedPolicy()));});
+    if(selected("l2Norm")) bench("l2Norm", "float vectorized", n, 4.0 * n, [&](){keep(l2Norm(a.view(), VectorizedPolicy()));});
+    if(selected("l2Norm")) bench("l2Norm", "float parallel", n, 4.0 * n, [&](){keep(l2Norm(a.view(), ParallelPolicy()));}, ThreadPool::global().concurrency());
+    if(selected("lInfNorm")) bench("lInfNorm", "float vectorized", n, 4.0 * n, [&](){keep(lInfNorm(a.view(), VectorizedPolicy()));});
+    if(selected("maxIndex")) bench("maxIndex", "float", n, 4.0 * n, [&](){keep(maxIndex(a.view()));});
+    if(selected("runningStats")) bench("runningStats", "float", n, 4.0 * n, [&](){keep(runningStats(a.view()).m2);});
+    if(selected("variance")) bench("variance", "float", n, 4.0 * n, [&](){keep(variance(a.view()));});
+    if(selected("entropy")) bench("entropy", "double fast log", n, 8.0 * n, [&](){keep(entropy(p.view(), VectorizedPolicy()));});
+  }
+}
+
+//Escapes the characters JSON requires in a string.
+std::string jsonString(const std::string& s){
+  std::string out = "\"";
+  for(char c : s){
+    if(c == '"' || c == '\\') out += '\\';
+    out += c;
+  }
+  return out + "\"";
+}
+
+void writeJson(std::ostream& o){
+  o << "{\n  \"hardware_concurrency\": " << std::thread::hardware_concurrency();
+#ifdef VMATH_SIMD
+  o << ",\n  \"simd\": true";
+#else
+  o << ",\n  \"simd\": false";
+#endif
+  o << ",\n  \"quick\": " << (config.quick ? "true" : "false");
+  o << ",\n  \"results\": [";
+  for(unsigned i = 0; i < results.size(); i++){
+    const BenchResult& r = results[i];
+    o << ((i == 0) ? "\n" : ",\n");
+    o << "    {\"name\": " << jsonString(r.name) << ", \"variant\": " << jsonString(r.variant);
+    o << ", \"elements\": " << r.elements << ", \"threads\": " << r.threads;
+    o << ", \"ns_per_element\": " << r.nsPerElement << ", \"gb_per_second\": " << r.gbPerSecond;
+    o << ", \"scaling_efficiency\": ";
+    if(r.scalingEfficiency < 0) o << "null";
+    else o << r.scalingEfficiency;
+    o << "}";
+  }
+  o << "\n  ]\n}" << std::endl;
+}
+
+int main(int argc, char** argv){
+  for(int i = 1; i < argc; i++){
+    if(strcmp(argv[i], "--quick") == 0){
+      config.quick = true;
+      config.minTrialSeconds = 0.01;
+      config.trials = 3;
+    }
+    else if(strcmp(argv[i], "--only") == 0 && i + 1 < argc){
+      config.only = argv[++i];
+    }
+    else{
+      std::cerr << "Usage: " << argv[0] << " [--quick] [--only name]" << std::endl;
+      return 1;
+    }
+  }
+  benchMap();
+  benchMapParallel();
+  benchFilter();
+  benchBitArray();
+  benchFold();
+  benchSort();
+  benchVectormath();
+  writeJson(std::cout);
+  return 0;
+}
@@ -0,0 +1,189 @@
+//Instrumentation
+//Optional timing of the parallel operators, for finding out whether a slow call is spent waking the pool, waiting on one overloaded thread, or in the user's function.
+
+//Compiled out unless VMATH_INSTRUMENT is defined (before including any of the headers): VMATH_INSTRUMENT_SCOPE then expands to nothing and the thread pool takes no timestamps, so there is no cost at all.
+//When enabled, each instrumented operation opens a scope naming itself and its element count, the thread pool times every thread's share of each job run within the scope, and when the scope closes its CallRecord is passed to the installed InstrumentSink (none by default, in which case records are discarded).
+//Scopes opened while another is open on the same thread are folded into the outer one, so a parallel sort is a single record covering its sorting and merging jobs.
+
+#ifndef INSTRUMENT_H
+#define INSTRUMENT_H
+
+#ifdef VMATH_INSTRUMENT
+
+#include <stdint.h>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <ostream>
+
+inline uint64_t instrumentNow(){
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//One thread's share of the jobs of a call.  Times are summed over the call's jobs.
+struct WorkerTiming {
+  unsigned tasks;
+  uint64_t busyNs;  //Running tasks.
+  uint64_t wakeNs;  //From the job being submitted to the thread starting on it (for the calling thread, its own dispatch overhead).
+
+  WorkerTiming() : tasks(0), busyNs(0), wakeNs(0) { }
+};
+
+struct CallRecord {
+  const char* operation;
+  unsigned long long elements;
+  uint64_t startNs; //On the steady clock.
+  uint64_t totalNs;
+  unsigned jobs;    //Thread pool jobs run by the call; 0 if it ran entirely on the calling thread.
+  unsigned tasks;
+  std::vector<WorkerTiming> workers; //Indexed by thread: 0 is the calling thread, i the ith pool worker.
+
+  CallRecord(const char* operation, unsigned long long elements) : operation(operation), elements(elements), startNs(instrumentNow()), totalNs(0), jobs(0), tasks(0) { }
+
+  //Busiest thread's time over the mean time of all the threads that were available, so 1 is a perfect balance and concurrency() means one thread did everything.
+  double imbalance() const {
+    uint64_t total = 0, most = 0;
+    for(unsigned i = 0; i < workers.size(); i++){
+      total += workers[i].busyNs;
+      if(workers[i].busyNs > most) most = workers[i].busyNs;
+    }
+    return (total == 0) ? 1 : (double)most * workers.size() / total;
+  }
+
+  //Time spent in tasks, summed over threads, per element.
+  double busyNsPerElement() const {
+    uint64_t total = 0;
+    for(unsigned i = 0; i < workers.size(); i++){
+      total += workers[i].busyNs;
+    }
+    return (elements == 0) ? 0 : (double)total / elements;
+  }
+};
+
+//Receives a CallRecord when each outermost instrumented call completes.  record may be called from any thread, including concurrently.
+class InstrumentSink {
+public:
+  virtual ~InstrumentSink(){ }
+  virtual void record(const CallRecord& call) = 0;
+};
+
+//Keeps the most recent capacity records in memory.
+class RingBufferSink : public InstrumentSink {
+public:
+  explicit RingBufferSink(unsigned capacity) : capacity(capacity), next(0), total(0) {
+    records.reserve(capacity);
+  }
+
+  void record(const CallRecord& call){
+    std::lock_guard<std::mutex> lock(mutex);
+    if(records.size() < capacity) records.push_back(call);
+    else records[next] = call;
+    next = (next + 1) % capacity;
+    total++;
+  }
+
+  //The retained records, oldest first.
+  std::vector<CallRecord> snapshot(){
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<CallRecord> out;
+    unsigned first = (records.size() < capacity) ? 0 : next;
+    for(unsigned i = 0; i < records.size(); i++){
+      out.push_back(records[(first + i) % records.size()]);
+    }
+    return out;
+  }
+
+  //Records received, including those since overwritten.
+  unsigned long long recorded(){
+    std::lock_guard<std::mutex> lock(mutex);
+    return total;
+  }
+
+  void clear(){
+    std::lock_guard<std::mutex> lock(mutex);
+    records.clear();
+    next = 0;
+  }
+
+private:
+  std::mutex mutex;
+  std::vector<CallRecord> records;
+  unsigned capacity;
+  unsigned next;
+  unsigned long long total;
+};
+
+//Writes each record to a stream as a line of JSON.
+class JsonSink : public InstrumentSink {
+public:
+  explicit JsonSink(std::ostream& out) : out(out) { }
+
+  void record(const CallRecord& call){
+    std::lock_guard<std::mutex> lock(mutex);
+    out << "{\"operation\": \"" << call.operation << "\", \"elements\": " << call.elements << ", \"total_ns\": " << call.totalNs;
+    out << ", \"jobs\": " << call.jobs << ", \"tasks\": " << call.tasks << ", \"imbalance\": " << call.imbalance() << ", \"workers\": [";
+    for(unsigned i = 0; i < call.workers.size(); i++){
+      const WorkerTiming& w = call.workers[i];
+      out << ((i == 0) ? "" : ", ") << "{\"tasks\": " << w.tasks << ", \"busy_ns\": " << w.busyNs << ", \"wake_ns\": " << w.wakeNs << "}";
+    }
+    out << "]}\n";
+  }
+
+private:
+  std::mutex mutex;
+  std::ostream& out;
+};
+
+inline std::atomic<InstrumentSink*>& instrumentSinkSlot(){
+  static std::atomic<InstrumentSink*> sink(nullptr);
+  return sink;
+}
+
+//Installs the sink for all threads, returning the previous one.  Pass nullptr to stop recording.  The sink must outlive its installation.
+inline InstrumentSink* setInstrumentSink(InstrumentSink* sink){
+  return instrumentSinkSlot().exchange(sink);
+}
+
+//Opens a record for the current thread's outermost instrumented call, and hands it to the sink when closed.
+class InstrumentScope {
+public:
+  InstrumentScope(const char* operation, unsigned long long elements) : active(false), call(operation, elements) {
+    if(current() != nullptr || instrumentSinkSlot().load(std::memory_order_relaxed) == nullptr) return;
+    active = true;
+    current() = &call;
+  }
+
+  ~InstrumentScope(){
+    if(!active) return;
+    current() = nullptr;
+    call.totalNs = instrumentNow() - call.startNs;
+    InstrumentSink* sink = instrumentSinkSlot().load();
+    if(sink != nullptr) sink->record(call);
+  }
+
+  InstrumentScope(const InstrumentScope&) = delete;
+  InstrumentScope& operator=(const InstrumentScope&) = delete;
+
+  //The open record of this thread, to which thread pool jobs are attributed, or nullptr.
+  static CallRecord*& current(){
+    static thread_local CallRecord* call = nullptr;
+    return call;
+  }
+
+private:
+  bool active;
+  CallRecord call;
+};
+
+#define VMATH_INSTRUMENT_CONCAT_(a, b) a##b
+#define VMATH_INSTRUMENT_CONCAT(a, b) VMATH_INSTRUMENT_CONCAT_(a, b)
+#define VMATH_INSTRUMENT_SCOPE(operation, elements) InstrumentScope VMATH_INSTRUMENT_CONCAT(instrumentScope, __LINE__)(operation, elements)
+
+#else
+
+#define VMATH_INSTRUMENT_SCOPE(operation, elements) ((void)0)
+
+#endif
+
+#endif
@@ -0,0 +1,272 @@
+//Lazy array expressions
+//Chains of map, zip, filter, take and drop over Arrays that are evaluated in a single fused pass when they are materialized or reduced, rather than allocating an Array for every intermediate step.
+
+//lazy(arr).map(f).zip(other, g).filter(p).materialize() reads arr and other once and writes only the final Array.
+
+#ifndef LAZY_H
+#define LAZY_H
+
+#include <type_traits>
+
+#include "array.hpp"
+
+template<typename T> struct LazyArray;
+template<typename E, typename F> struct LazyMap;
+template<typename E0, typename E1, typename F> struct LazyZip;
+template<typename E, typename F> struct LazyFilter;
+template<typename E> struct LazyTake;
+template<typename E> struct LazyDrop;
+
+//Operations shared by every lazy expression E.
+//An expression has a value_type, a length() (exact, or an upper bound once a filter is involved), and push(sink), which passes each element in order to sink until sink returns false.
+//Expressions without a filter are indexable: their length is exact and at(i) computes element i directly, which lets materialize and fold run as plain counted loops that the compiler can vectorize.
+//Expressions hold their operands (Arrays and functions) by value, so they are cheap to copy but must not outlive the Arrays they read.
+template<typename E> struct LazyOps {
+  const E& self() const {
+    return static_cast<const E&>(*this);
+  }
+
+  //Builders
+
+  template<typename F> LazyMap<E, F> map(F f) const {
+    return LazyMap<E, F>(self(), f);
+  }
+
+  //Both operands must be indexable and of the same length.
+  template<typename E1, typename F> LazyZip<E, E1, F> zip(const LazyOps<E1>& other, F f) const {
+    return LazyZip<E, E1, F>(self(), other.self(), f);
+  }
+  template<typename U, typename F> LazyZip<E, LazyArray<U>, F> zip(const Array<U> other, F f) const {
+    return LazyZip<E, LazyArray<U>, F>(self(), LazyArray<U>(other), f);
+  }
+
+  template<typename F> LazyFilter<E, F> filter(F f) const {
+    return LazyFilter<E, F>(self(), f);
+  }
+
+  LazyTake<E> take(ArraySize count) const {
+    return LazyTake<E>(self(), count);
+  }
+
+  LazyDrop<E> drop(ArraySize count) const {
+    return LazyDrop<E>(self(), count);
+  }
+
+  //Evaluators
+
+  //Evaluates the expression into a new Array.  When the expression is filtered, the Array is allocated at length() and shortened to the number of elements produced, as with Array::filter.
+  template<typename Self = E> OwnedArray<typename Self::value_type> materialize() const {
+    typedef typename Self::value_type V;
+    OwnedArray<V> out = OwnedArray<V>(self().length());
+    out.length = materializeTo(out.data, std::integral_constant<bool, Self::indexable>());
+    return out;
+  }
+
+  template<typename ResultTy, typename F> ResultTy fold(F f, ResultTy zero) const {
+    return foldImpl(f, zero, std::integral_constant<bool, E::indexable>());
+  }
+
+  template<typename Self = E> typename Self::value_type sumTerms() const {
+    typedef typename Self::value_type V;
+    return fold([](const V acc, const V next){return acc + next;}, (V)0);
+  }
+
+  //Passes each element to f.
+  template<typename F> void forEach(F f) const {
+    self().push([&f](const typename E::value_type& v){f(v); return true;});
+  }
+
+private:
+  template<typename V> ArraySize materializeTo(V* out, std::true_type) const {
+    const E& e = self();
+    ArraySize len = e.length();
+    for(ArraySize i = 0; i < len; i++){
+      out[i] = e.at(i);
+    }
+    return len;
+  }
+  template<typename V> ArraySize materializeTo(V* out, std::false_type) const {
+    ArraySize count = 0;
+    self().push([out, &count](const V& v){out[count++] = v; return true;});
+    return count;
+  }
+
+  template<typename ResultTy, typename F> ResultTy foldImpl(F& f, ResultTy zero, std::true_type) const {
+    const E& e = self();
+    ArraySize len = e.length();
+    ResultTy acc = zero;
+    for(ArraySize i = 0; i < len; i++){
+      acc = f(acc, e.at(i));
+    }
+    return acc;
+  }
+  template<typename ResultTy, typename F> ResultTy foldImpl(F& f, ResultTy zero, std::false_type) const {
+    ResultTy acc = zero;
+    self().push([&acc, &f](const typename E::value_type& v){acc = f(acc, v); return true;});
+    return acc;
+  }
+};
+
+//Pushes elements 0 through length() - 1 of an indexable expression.
+template<typename E, typename S> bool pushIndexed(const E& e, S& sink){
+  ArraySize len = e.length();
+  for(ArraySize i = 0; i < len; i++){
+    if(!sink(e.at(i))) return false;
+  }
+  return true;
+}
+
+//Leaf expression reading an Array.
+template<typename T> struct LazyArray : LazyOps<LazyArray<T>> {
+  typedef T value_type;
+  static const bool indexable = true;
+
+  Array<T> arr;
+
+  LazyArray(const Array<T> arr) : arr(arr) { }
+
+  ArraySize length() const {
+    return arr.length;
+  }
+  T at(ArraySize i) const {
+    return arr.data[i];
+  }
+  template<typename S> bool push(S&& sink) const {
+    return pushIndexed(*this, sink);
+  }
+};
+
+template<typename E, typename F> struct LazyMap : LazyOps<LazyMap<E, F>> {
+  typedef typename E::value_type In;
+  typedef CallResult<F, In> value_type;
+  static const bool indexable = E::indexable;
+
+  E src;
+  F f;
+
+  LazyMap(const E& src, F f) : src(src), f(f) { }
+
+  ArraySize length() const {
+    return src.length();
+  }
+  value_type at(ArraySize i) const {
+    return f(src.at(i));
+  }
+  template<typename S> bool push(S&& sink) const {
+    const F& fn = f;
+    return src.push([&sink, &fn](const In& v){return sink(fn(v));});
+  }
+};
+
+template<typename E0, typename E1, typename F> struct LazyZip : LazyOps<LazyZip<E0, E1, F>> {
+  static_assert(E0::indexable && E1::indexable, "zip requires indexable (unfiltered) operands.");
+  typedef CallResult<F, typename E0::value_type, typename E1::value_type> value_type;
+  static const bool indexable = true;
+
+  E0 src0;
+  E1 src1;
+  F f;
+
+  LazyZip(const E0& src0, const E1& src1, F f) : src0(src0), src1(src1), f(f) {
+    VMATH_CHECK_BOUNDS(src0.length() == src1.length());
+  }
+
+  ArraySize length() const {
+    return src0.length();
+  }
+  value_type at(ArraySize i) const {
+    return f(src0.at(i), src1.at(i));
+  }
+  template<typename S> bool push(S&& sink) const {
+    return pushIndexed(*this, sink);
+  }
+};
+
+template<typename E, typename F> struct LazyFilter : LazyOps<LazyFilter<E, F>> {
+  typedef typename E::value_type value_type;
+  static const bool indexable = false;
+
+  E src;
+  F f;
+
+  LazyFilter(const E& src, F f) : src(src), f(f) { }
+
+  //Upper bound.
+  ArraySize length() const {
+    return src.length();
+  }
+  template<typename S> bool push(S&& sink) const {
+    const F& pred = f;
+    return src.push([&sink, &pred](const value_type& v){return pred(v) ? sink(v) : true;});
+  }
+};
+
+template<typename E> struct LazyTake : LazyOps<LazyTake<E>> {
+  typedef typename E::value_type value_type;
+  static const bool indexable = E::indexable;
+
+  E src;
+  ArraySize count;
+
+  LazyTake(const E& src, ArraySize count) : src(src), count(count) {
+    VMATH_CHECK_BOUNDS(!indexable || count <= src.length());
+  }
+
+  ArraySize length() const {
+    return std::min(count, src.length());
+  }
+  value_type at(ArraySize i) const {
+    return src.at(i);
+  }
+  //Stops pulling from the source once count elements have been produced.
+  template<typename S> bool push(S&& sink) const {
+    if(count == 0) return true;
+    ArraySize remaining = count;
+    bool sinkStopped = false;
+    src.push([&sink, &remaining, &sinkStopped](const value_type& v){
+      if(!sink(v)){
+        sinkStopped = true;
+        return false;
+      }
+      return --remaining > 0;
+    });
+    return !sinkStopped;
+  }
+};
+
+template<typename E> struct LazyDrop : LazyOps<LazyDrop<E>> {
+  typedef typename E::value_type value_type;
+  static const bool indexable = E::indexable;
+
+  E src;
+  ArraySize count;
+
+  LazyDrop(const E& src, ArraySize count) : src(src), count(count) {
+    VMATH_CHECK_BOUNDS(!indexable || count <= src.length());
+  }
+
+  ArraySize length() const {
+    ArraySize len = src.length();
+    return (len > count) ? len - count : 0;
+  }
+  value_type at(ArraySize i) const {
+    return src.at(i + count);
+  }
+  template<typename S> bool push(S&& sink) const {
+    ArraySize skip = count;
+    return src.push([&sink, &skip](const value_type& v){
+      if(skip > 0){
+        skip--;
+        return true;
+      }
+      return sink(v);
+    });
+  }
+};
+
+//Starts a lazy expression over arr.
+template<typename T> LazyArray<T> lazy(const Array<T> arr){
+  return LazyArray<T>(arr);
+}
+
+#endif
@@ -0,0 +1,99 @@
+//Contiguous matrix
+//A row-major 2D container whose rows are Arrays, for data sets of many equal-length vectors (such as feature matrices).
+
+//All elements live in a single allocation, row i occupying elements [i * cols, (i + 1) * cols), so whole-matrix passes stream through memory in order rather than chasing a pointer per row.
+//Column statistics over a Matrix are in vectormath.hpp.
+
+#ifndef MATRIX_H
+#define MATRIX_H
+
+#include "array.hpp"
+#include "strided.hpp"
+
+//Like OwnedArray, a Matrix owns its elements and can be moved but not copied; Arrays taken from it (rows, columns and views) must not outlive it.
+template <typename T> struct Matrix {
+  //Fields
+  ArraySize rows;
+  ArraySize cols;
+  OwnedArray<T> elements;
+
+  //Constructors
+  Matrix() : rows(0), cols(0) { }
+
+  //Empty matrix (Warning: No initialization)
+  Matrix(ArraySize rows, ArraySize cols) : rows(rows), cols(cols), elements(checkedSize(rows, cols)) { }
+
+  //Initialize matrix to value
+  Matrix(ArraySize rows, ArraySize cols, T val) : rows(rows), cols(cols), elements(checkedSize(rows, cols), val) { }
+
+  //Copies the rows of a jagged matrix, which must all have the same length.
+  static Matrix<T> fromRows(Array<Array<T>> in){
+    Matrix<T> m(in.length, (in.length == 0) ? 0 : in[0].length);
+    for(ArraySize i = 0; i < m.rows; i++){
+      VMATH_CHECK_BOUNDS(in[i].length == m.cols);
+      std::copy(in[i].data, in[i].data + m.cols, m.row(i).data);
+    }
+    return m;
+  }
+
+  Matrix(Matrix<T>&& other) : rows(other.rows), cols(other.cols), elements(std::move(other.elements)) {
+    other.rows = 0;
+    other.cols = 0;
+  }
+  Matrix<T>& operator=(Matrix<T>&& other){
+    rows = other.rows;
+    cols = other.cols;
+    elements = std::move(other.elements);
+    if(this != &other){
+      other.rows = 0;
+      other.cols = 0;
+    }
+    return *this;
+  }
+
+  //Accessors
+  T& operator()(ArraySize i, ArraySize j) const {
+    VMATH_CHECK_BOUNDS(i < rows && j < cols);
+    return elements.data[i * cols + j];
+  }
+
+  Array<T> row(ArraySize i) const {
+    VMATH_CHECK_BOUNDS(i < rows);
+    return Array<T>(elements.data + i * cols, cols);
+  }
+
+  //Column j, read in place with a stride of cols.
+  StridedArray<T> column(ArraySize j) const {
+    VMATH_CHECK_BOUNDS(j < cols);
+    return StridedArray<T>(elements.data + j, rows, cols);
+  }
+
+  //The elements of rows [first, last).
+  Array<T> rowRange(ArraySize first, ArraySize last) const {
+    VMATH_CHECK_BOUNDS(first <= last && last <= rows);
+    return Array<T>(elements.data + first * cols, (last - first) * cols);
+  }
+
+  //All elements, row by row.
+  Array<T> view() const {
+    return elements.view();
+  }
+
+  T* data() const {
+    return elements.data;
+  }
+
+  Matrix<T> clone() const {
+    Matrix<T> copy(rows, cols);
+    std::copy(elements.data, elements.data + elements.length, copy.elements.data);
+    return copy;
+  }
+
+private:
+  static ArraySize checkedSize(ArraySize rows, ArraySize cols){
+    VMATH_CHECK_BOUNDS(cols == 0 || rows <= (ArraySize)-1 / cols); //The element count must not overflow.
+    return rows * cols;
+  }
+};
+
+#endif
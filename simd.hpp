@@ -0,0 +1,578 @@
+//SIMD kernels
+//Vectorized inner loops for vectormath.hpp, with the instruction set (SSE2, AVX2 or AVX-512) chosen at run time on x86-64.
+
+//Kernels are written once with GCC vector extensions, parameterized on the vector width in bytes, and compiled for each instruction set by inlining them into a dispatch function carrying the matching target attribute.
+//On other platforms and compilers, or when VMATH_NO_SIMD is defined, VMATH_SIMD is left undefined and vectormath.hpp uses its generic loops.
+
+#ifndef SIMD_H
+#define SIMD_H
+
+#if !defined(VMATH_NO_SIMD) && defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define VMATH_SIMD 1
+#endif
+
+//Functions that vectors pass through must be inlined into the kernels; see SimdVec.
+#ifdef VMATH_SIMD
+#define SIMD_INLINE inline __attribute__((always_inline))
+#else
+#define SIMD_INLINE inline
+#endif
+
+#ifdef VMATH_SIMD
+
+#include <stddef.h>
+#include <stdint.h>
+
+enum SimdLevel { SIMD_SSE2 = 0, SIMD_AVX2 = 1, SIMD_AVX512 = 2 };
+
+//Best instruction set supported by this CPU and OS.  SSE2 is part of x86-64, so it is always available.
+inline SimdLevel simdDetectedLevel(){
+  static const SimdLevel level = [](){
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx512f")) return SIMD_AVX512;
+    if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return SIMD_AVX2;
+    return SIMD_SSE2;
+  }();
+  return level;
+}
+
+//Highest instruction set the kernels may use, for comparing the paths in tests and benchmarks.  Set it before starting work on other threads.
+inline SimdLevel& simdLevelLimit(){
+  static SimdLevel limit = SIMD_AVX512;
+  return limit;
+}
+
+inline SimdLevel simdActiveLevel(){
+  SimdLevel detected = simdDetectedLevel();
+  return (simdLevelLimit() < detected) ? simdLevelLimit() : detected;
+}
+
+//Integer type the width of T, for lane masks.
+template<unsigned Size> struct SimdLaneInt;
+template<> struct SimdLaneInt<4> { typedef int32_t type; };
+template<> struct SimdLaneInt<8> { typedef int64_t type; };
+
+//Vector types and unaligned loads.  V is a vector of Bytes / sizeof(T) lanes of T.
+//Vectors are only passed by reference between these helpers, since passing them by value from code compiled without the wider instruction set has no agreed calling convention.
+template<typename T, unsigned Bytes> struct SimdVec {
+  typedef T V __attribute__((vector_size(Bytes)));
+  typedef T Unaligned __attribute__((vector_size(Bytes), aligned(sizeof(T)), may_alias));
+  typedef typename SimdLaneInt<sizeof(T)>::type I;
+  typedef I Mask __attribute__((vector_size(Bytes)));
+  static const unsigned lanes = Bytes / sizeof(T);
+
+  static SIMD_INLINE const Unaligned& load(const T* p){
+    return *(const Unaligned*)p;
+  }
+
+  //All-ones lanes where the corresponding bool is set.
+  static SIMD_INLINE void loadMask(Mask& m, const bool* p){
+    typedef uint8_t B __attribute__((vector_size(lanes), aligned(1), may_alias));
+    m = __builtin_convertvector(*(const B*)p, Mask) != 0;
+  }
+
+  static SIMD_INLINE T sum(const V& v){
+    T s = v[0];
+    for(unsigned j = 1; j < lanes; j++){
+      s += v[j];
+    }
+    return s;
+  }
+};
+
+//Runs the kernel K<Bytes>::run at the widest vector width the active instruction set allows.
+template<template<unsigned> class K, typename... A> __attribute__((target("avx512f"))) auto simdRunAvx512(A... a) -> decltype(K<64>::run(a...)) {
+  return K<64>::run(a...);
+}
+template<template<unsigned> class K, typename... A> __attribute__((target("avx2,fma"))) auto simdRunAvx2(A... a) -> decltype(K<32>::run(a...)) {
+  return K<32>::run(a...);
+}
+template<template<unsigned> class K, typename... A> auto simdRunSse2(A... a) -> decltype(K<16>::run(a...)) {
+  return K<16>::run(a...);
+}
+
+template<template<unsigned> class K, typename... A> auto simdDispatch(A... a) -> decltype(K<16>::run(a...)) {
+  switch(simdActiveLevel()){
+    case SIMD_AVX512: return simdRunAvx512<K>(a...);
+    case SIMD_AVX2: return simdRunAvx2<K>(a...);
+    default: return simdRunSse2<K>(a...);
+  }
+}
+
+/////////////
+//REDUCTION//
+/////////////
+
+//Reduces the terms of d[i] over i with Op::combine, starting from Op::identity (see the reduction ops in vectormath.hpp).
+//term and combine are templates applied to whole vectors and to single values alike, and combine must be associative and commutative.
+template<unsigned Bytes> struct SimdReduce {
+  template<typename Op, typename T> static SIMD_INLINE T run(Op, const T* d, size_t len){
+    typedef SimdVec<T, Bytes> S;
+    typedef typename S::V V;
+    const unsigned lanes = S::lanes;
+    V acc0 = {};
+    acc0 += Op::template identity<T>();
+    V acc1 = acc0, acc2 = acc0, acc3 = acc0;
+    size_t i = 0;
+    for(; len - i >= 4 * lanes; i += 4 * lanes){
+      V x0 = S::load(d + i);
+      V x1 = S::load(d + i + lanes);
+      V x2 = S::load(d + i + 2 * lanes);
+      V x3 = S::load(d + i + 3 * lanes);
+      Op::term(x0);
+      Op::term(x1);
+      Op::term(x2);
+      Op::term(x3);
+      Op::combine(acc0, x0);
+      Op::combine(acc1, x1);
+      Op::combine(acc2, x2);
+      Op::combine(acc3, x3);
+    }
+    for(; len - i >= lanes; i += lanes){
+      V x = S::load(d + i);
+      Op::term(x);
+      Op::combine(acc0, x);
+    }
+    Op::combine(acc0, acc1);
+    Op::combine(acc2, acc3);
+    Op::combine(acc0, acc2);
+    T r = acc0[0];
+    for(unsigned j = 1; j < lanes; j++){
+      T x = acc0[j];
+      Op::combine(r, x);
+    }
+    for(; i < len; i++){
+      T x = d[i];
+      Op::term(x);
+      Op::combine(r, x);
+    }
+    return r;
+  }
+};
+
+///////
+//LOG//
+///////
+
+//Natural log of each lane of x, for positive normal x.
+//x is split into 2^e m with m in [sqrt(1/2), sqrt(2)), and log(m) is computed from the series log(m) = 2 atanh(s) = 2 (s + s^3 / 3 + s^5 / 5 + ...), where s = (m - 1) / (m + 1) and |s| < 0.172.
+//The series is cut off after 5 terms for float and 10 for double, where the truncation error (below 1e-9 and 1e-17) is well under the rounding of the arithmetic, so the result is within a few ulps of log(x).  Measured over 4M values the error was below 1.2e-7 (float) and 2.5e-16 (double), absolute where |log(x)| < 1 and relative elsewhere; the documented bounds are 2e-7 and 4e-16.
+//Lanes holding zero, negative, subnormal or non-finite values get meaningless (but finite) results and should be selected away.
+template<typename T> struct SimdLogTraits;
+template<> struct SimdLogTraits<float> {
+  static const int mantissaBits = 23;
+  static const int exponentBias = 127;
+  static const int terms = 5;
+};
+template<> struct SimdLogTraits<double> {
+  static const int mantissaBits = 52;
+  static const int exponentBias = 1023;
+  static const int terms = 10;
+};
+
+template<typename T, unsigned Bytes> SIMD_INLINE void simdLog(typename SimdVec<T, Bytes>::V& x){
+  typedef SimdVec<T, Bytes> S;
+  typedef typename S::V V;
+  typedef typename S::Mask Mask;
+  typedef typename S::I I;
+  typedef SimdLogTraits<T> L;
+  const I mantissaMask = ((I)1 << L::mantissaBits) - 1;
+  const I exponentMask = (I)(2 * L::exponentBias + 1);
+  const I oneBits = (I)L::exponentBias << L::mantissaBits;
+
+  Mask bits = (Mask)x;
+  Mask e = ((bits >> L::mantissaBits) & exponentMask) - (I)L::exponentBias;
+  V m = (V)((bits & mantissaMask) | oneBits);
+  Mask big = m > (T)1.41421356237309504880;
+  m = big ? m * (T)0.5 : m;
+  e -= big; //big is -1 in the lanes it selects.
+
+  V s = (m - (T)1) / (m + (T)1);
+  V z = s * s;
+  V series = {};
+  series += (T)1 / (2 * L::terms - 1);
+  for(int k = L::terms - 2; k >= 0; k--){
+    series = series * z + (T)1 / (2 * k + 1);
+  }
+  x = __builtin_convertvector(e, V) * (T)0.69314718055994530942 + (T)2 * s * series;
+}
+
+//Sum of the len values of d, written to sum, and sum of -d[i] log(d[i]) over the positive d[i], returned, both accumulated in one pass.
+//Whether every d[i] is positive (so not zero, negative or NaN) is written to allPositive, and whether every one is nonnegative (so not negative or NaN) to allNonNegative, from the same pass.
+template<unsigned Bytes> struct SimdEntropy {
+  template<typename T> static SIMD_INLINE T run(const T* d, size_t len, T* sum, bool* allPositive, bool* allNonNegative){
+    typedef SimdVec<T, Bytes> S;
+    typedef typename S::V V;
+    typedef typename S::Mask Mask;
+    const unsigned lanes = S::lanes;
+    const V zero = {};
+    V sum0 = {}, sum1 = {}, ent0 = {}, ent1 = {};
+    Mask notPositive = {}, negative = {};
+    size_t i = 0;
+    for(; len - i >= 2 * lanes; i += 2 * lanes){
+      V x0 = S::load(d + i);
+      V x1 = S::load(d + i + lanes);
+      sum0 += x0;
+      sum1 += x1;
+      V l0 = x0, l1 = x1;
+      simdLog<T, Bytes>(l0);
+      simdLog<T, Bytes>(l1);
+      Mask pos0 = x0 > (T)0;
+      Mask pos1 = x1 > (T)0;
+      ent0 -= pos0 ? x0 * l0 : zero;
+      ent1 -= pos1 ? x1 * l1 : zero;
+      notPositive |= ~(pos0 & pos1);
+      negative |= ~((x0 >= (T)0) & (x1 >= (T)0));
+    }
+    bool positive = true, nonNegative = true;
+    //The rest goes through one zero-padded vector, zeros contributing nothing.
+    for(; i < len; i += lanes){
+      T rest[lanes] = {};
+      for(unsigned j = 0; j < lanes && i + j < len; j++){
+        rest[j] = d[i + j];
+        positive = positive && rest[j] > 0;
+        nonNegative = nonNegative && rest[j] >= 0;
+      }
+      V x = S::load(rest);
+      sum0 += x;
+      V l = x;
+      simdLog<T, Bytes>(l);
+      Mask pos = x > (T)0;
+      ent0 -= pos ? x * l : zero;
+    }
+    for(unsigned j = 0; j < lanes; j++){
+      positive = positive && notPositive[j] == 0;
+      nonNegative = nonNegative && negative[j] == 0;
+    }
+    *sum = S::sum(sum0 + sum1);
+    *allPositive = positive;
+    *allNonNegative = nonNegative;
+    return S::sum(ent0 + ent1);
+  }
+};
+
+/////////////////////
+//ARGMAX AND ARGMIN//
+/////////////////////
+
+//Index of the first greatest (or, if not Greatest, least) of the len > 0 elements of d, which is what maxIndex and minIndex compute.
+//Each lane keeps the best value it has seen and the iteration it was seen in, so a lane only moves to a later element when it is strictly better; the lanes are combined at the end, lower index first among equal values.
+//Nothing compares better than a NaN or is beaten by one, so NaNs are passed over, as in the scalar loops, and if d[0] is NaN the result is 0.
+template<unsigned Bytes, bool Greatest, typename T> SIMD_INLINE size_t simdArgExtreme(const T* d, size_t len){
+  typedef SimdVec<T, Bytes> S;
+  typedef typename S::V V;
+  typedef typename S::Mask Mask;
+  const unsigned lanes = S::lanes;
+  V best0 = {}, best1 = {};
+  best0 += d[0];
+  best1 += d[0];
+  Mask iter0 = {}, iter1 = {}, iteration = {};
+  //The iteration counters are lane-width integers, so very long inputs finish in the scalar loop rather than let them wrap.
+  const size_t vectorLimit = ((size_t)1 << 31) * 2 * lanes;
+  const size_t vectorEnd = (len - len % (2 * lanes) < vectorLimit) ? len - len % (2 * lanes) : vectorLimit;
+  size_t i = 0;
+  for(; i < vectorEnd; i += 2 * lanes){
+    V x0 = S::load(d + i);
+    V x1 = S::load(d + i + lanes);
+    Mask better0 = Greatest ? (x0 > best0) : (x0 < best0);
+    Mask better1 = Greatest ? (x1 > best1) : (x1 < best1);
+    best0 = better0 ? x0 : best0;
+    best1 = better1 ? x1 : best1;
+    iter0 = better0 ? iteration : iter0;
+    iter1 = better1 ? iteration : iter1;
+    iteration += 1;
+  }
+
+  //Lanes that never moved still hold d[0], which loses to the real d[0] by index.
+  T bestValue = d[0];
+  size_t bestIndex = 0;
+  for(unsigned j = 0; j < 2 * lanes; j++){
+    T v = (j < lanes) ? best0[j] : best1[j - lanes];
+    size_t index = (size_t)((j < lanes) ? iter0[j] : iter1[j - lanes]) * 2 * lanes + j;
+    if((Greatest ? v > bestValue : v < bestValue) || (v == bestValue && index < bestIndex)){
+      bestValue = v;
+      bestIndex = index;
+    }
+  }
+  for(; i < len; i++){
+    if(Greatest ? d[i] > bestValue : d[i] < bestValue){
+      bestValue = d[i];
+      bestIndex = i;
+    }
+  }
+  return bestIndex;
+}
+
+template<unsigned Bytes> struct SimdMaxIndex {
+  template<typename T> static SIMD_INLINE size_t run(const T* d, size_t len){
+    return simdArgExtreme<Bytes, true>(d, len);
+  }
+};
+
+template<unsigned Bytes> struct SimdMinIndex {
+  template<typename T> static SIMD_INLINE size_t run(const T* d, size_t len){
+    return simdArgExtreme<Bytes, false>(d, len);
+  }
+};
+
+////////////
+//DISTANCE//
+////////////
+
+//The distance kernels keep four independent accumulators so that consecutive vector additions do not wait on each other.
+
+template<unsigned Bytes> struct SimdDistanceSquared {
+  template<typename T> static SIMD_INLINE T run(const T* d0, const T* d1, size_t len){
+    typedef SimdVec<T, Bytes> S;
+    typedef typename S::V V;
+    const unsigned lanes = S::lanes;
+    V acc0 = {}, acc1 = {}, acc2 = {}, acc3 = {};
+    size_t i = 0;
+    for(; len - i >= 4 * lanes; i += 4 * lanes){
+      V x0 = S::load(d0 + i) - S::load(d1 + i);
+      V x1 = S::load(d0 + i + lanes) - S::load(d1 + i + lanes);
+      V x2 = S::load(d0 + i + 2 * lanes) - S::load(d1 + i + 2 * lanes);
+      V x3 = S::load(d0 + i + 3 * lanes) - S::load(d1 + i + 3 * lanes);
+      acc0 += x0 * x0;
+      acc1 += x1 * x1;
+      acc2 += x2 * x2;
+      acc3 += x3 * x3;
+    }
+    for(; len - i >= lanes; i += lanes){
+      V x = S::load(d0 + i) - S::load(d1 + i);
+      acc0 += x * x;
+    }
+    T ds = S::sum((acc0 + acc1) + (acc2 + acc3));
+    for(; i < len; i++){
+      ds += (d0[i] - d1[i]) * (d0[i] - d1[i]);
+    }
+    return ds;
+  }
+};
+
+template<unsigned Bytes> struct SimdDistanceWeightedSquared {
+  template<typename T> static SIMD_INLINE T run(const T* d0, const T* d1, const T* w, size_t len){
+    typedef SimdVec<T, Bytes> S;
+    typedef typename S::V V;
+    const unsigned lanes = S::lanes;
+    V acc0 = {}, acc1 = {}, acc2 = {}, acc3 = {};
+    size_t i = 0;
+    for(; len - i >= 4 * lanes; i += 4 * lanes){
+      V x0 = S::load(d0 + i) - S::load(d1 + i);
+      V x1 = S::load(d0 + i + lanes) - S::load(d1 + i + lanes);
+      V x2 = S::load(d0 + i + 2 * lanes) - S::load(d1 + i + 2 * lanes);
+      V x3 = S::load(d0 + i + 3 * lanes) - S::load(d1 + i + 3 * lanes);
+      acc0 += x0 * x0 * S::load(w + i);
+      acc1 += x1 * x1 * S::load(w + i + lanes);
+      acc2 += x2 * x2 * S::load(w + i + 2 * lanes);
+      acc3 += x3 * x3 * S::load(w + i + 3 * lanes);
+    }
+    for(; len - i >= lanes; i += lanes){
+      V x = S::load(d0 + i) - S::load(d1 + i);
+      acc0 += x * x * S::load(w + i);
+    }
+    T ds = S::sum((acc0 + acc1) + (acc2 + acc3));
+    for(; i < len; i++){
+      ds += (d0[i] - d1[i]) * (d0[i] - d1[i]) * w[i];
+    }
+    return ds;
+  }
+};
+
+//Lanes whose switch is off are selected away rather than multiplied by zero, so they are ignored even when they hold infinities or NaNs.
+template<unsigned Bytes> struct SimdDistanceSwitchedSquared {
+  template<typename T> static SIMD_INLINE T run(const T* d0, const T* d1, const bool* w, size_t len){
+    typedef SimdVec<T, Bytes> S;
+    typedef typename S::V V;
+    const unsigned lanes = S::lanes;
+    typedef typename S::Mask Mask;
+    const V zero = {};
+    V acc0 = {}, acc1 = {};
+    Mask m0, m1;
+    size_t i = 0;
+    for(; len - i >= 2 * lanes; i += 2 * lanes){
+      V x0 = S::load(d0 + i) - S::load(d1 + i);
+      V x1 = S::load(d0 + i + lanes) - S::load(d1 + i + lanes);
+      S::loadMask(m0, w + i);
+      S::loadMask(m1, w + i + lanes);
+      x0 = m0 ? x0 : zero;
+      x1 = m1 ? x1 : zero;
+      acc0 += x0 * x0;
+      acc1 += x1 * x1;
+    }
+    T ds = S::sum(acc0 + acc1);
+    for(; i < len; i++){
+      if(w[i]) ds += (d0[i] - d1[i]) * (d0[i] - d1[i]);
+    }
+    return ds;
+  }
+};
+
+//As SimdDistanceSwitchedSquared, with the switches packed one per bit (switch i is bit i % 64 of w[i / 64], as in BitArray).
+//Each step's bits are broadcast to every lane and tested against the lane's own bit, so no bools are loaded and nothing branches.
+template<unsigned Bytes> struct SimdDistanceSwitchedBitsSquared {
+  template<typename T> static SIMD_INLINE T run(const T* d0, const T* d1, const uint64_t* w, size_t len){
+    typedef SimdVec<T, Bytes> S;
+    typedef typename S::V V;
+    typedef typename S::I I;
+    typedef typename S::Mask Mask;
+    const unsigned lanes = S::lanes;
+    const V zero = {};
+    Mask laneBits;
+    for(unsigned j = 0; j < lanes; j++){
+      laneBits[j] = (I)1 << j;
+    }
+    V acc0 = {}, acc1 = {};
+    size_t i = 0;
+    for(; len - i >= 2 * lanes; i += 2 * lanes){
+      //2 * lanes divides 64, so a step's bits never straddle two words.
+      uint64_t bits = w[i / 64] >> (i % 64);
+      Mask b0 = {}, b1 = {};
+      b0 += (I)bits;
+      b1 += (I)(bits >> lanes);
+      Mask m0 = (b0 & laneBits) != 0;
+      Mask m1 = (b1 & laneBits) != 0;
+      V x0 = S::load(d0 + i) - S::load(d1 + i);
+      V x1 = S::load(d0 + i + lanes) - S::load(d1 + i + lanes);
+      x0 = m0 ? x0 : zero;
+      x1 = m1 ? x1 : zero;
+      acc0 += x0 * x0;
+      acc1 += x1 * x1;
+    }
+    T ds = S::sum(acc0 + acc1);
+    for(; i < len; i++){
+      if((w[i / 64] >> (i % 64)) & 1) ds += (d0[i] - d1[i]) * (d0[i] - d1[i]);
+    }
+    return ds;
+  }
+};
+
+//Dot product.
+template<unsigned Bytes> struct SimdDot {
+  template<typename T> static SIMD_INLINE T run(const T* d0, const T* d1, size_t len){
+    typedef SimdVec<T, Bytes> S;
+    typedef typename S::V V;
+    const unsigned lanes = S::lanes;
+    V acc0 = {}, acc1 = {}, acc2 = {}, acc3 = {};
+    size_t i = 0;
+    for(; len - i >= 4 * lanes; i += 4 * lanes){
+      acc0 += S::load(d0 + i) * S::load(d1 + i);
+      acc1 += S::load(d0 + i + lanes) * S::load(d1 + i + lanes);
+      acc2 += S::load(d0 + i + 2 * lanes) * S::load(d1 + i + 2 * lanes);
+      acc3 += S::load(d0 + i + 3 * lanes) * S::load(d1 + i + 3 * lanes);
+    }
+    for(; len - i >= lanes; i += lanes){
+      acc0 += S::load(d0 + i) * S::load(d1 + i);
+    }
+    T dot = S::sum((acc0 + acc1) + (acc2 + acc3));
+    for(; i < len; i++){
+      dot += d0[i] * d1[i];
+    }
+    return dot;
+  }
+};
+
+//Adds the dot products of len components of aCount rows of a with bCount rows of b (rows stride elements apart) into out[i * outStride + j].
+//Each row of b is loaded once per four rows of a, which also gives four independent accumulators.
+template<unsigned Bytes> struct SimdDotTile {
+  template<typename T> static SIMD_INLINE void run(const T* a, size_t aCount, const T* b, size_t bCount, size_t stride, size_t len, T* out, size_t outStride){
+    typedef SimdVec<T, Bytes> S;
+    typedef typename S::V V;
+    const unsigned lanes = S::lanes;
+    for(size_t j = 0; j < bCount; j++){
+      const T* bj = b + (size_t)j * stride;
+      size_t i = 0;
+      for(; aCount - i >= 4; i += 4){
+        const T* a0 = a + (size_t)i * stride;
+        const T* a1 = a0 + stride;
+        const T* a2 = a1 + stride;
+        const T* a3 = a2 + stride;
+        V acc0 = {}, acc1 = {}, acc2 = {}, acc3 = {};
+        size_t k = 0;
+        for(; len - k >= lanes; k += lanes){
+          V bv = S::load(bj + k);
+          acc0 += S::load(a0 + k) * bv;
+          acc1 += S::load(a1 + k) * bv;
+          acc2 += S::load(a2 + k) * bv;
+          acc3 += S::load(a3 + k) * bv;
+        }
+        T dot0 = S::sum(acc0), dot1 = S::sum(acc1), dot2 = S::sum(acc2), dot3 = S::sum(acc3);
+        for(; k < len; k++){
+          dot0 += a0[k] * bj[k];
+          dot1 += a1[k] * bj[k];
+          dot2 += a2[k] * bj[k];
+          dot3 += a3[k] * bj[k];
+        }
+        out[(size_t)i * outStride + j] += dot0;
+        out[(size_t)(i + 1) * outStride + j] += dot1;
+        out[(size_t)(i + 2) * outStride + j] += dot2;
+        out[(size_t)(i + 3) * outStride + j] += dot3;
+      }
+      for(; i < aCount; i++){
+        out[(size_t)i * outStride + j] += SimdDot<Bytes>::run(a + (size_t)i * stride, bj, len);
+      }
+    }
+  }
+};
+
+//////////////
+//BIT ARRAYS//
+//////////////
+
+//Applies Op::apply(x, y), which must work on single words and on vectors of them alike, to the n words of a and b, writing the results to out (which may be a or b).
+template<unsigned Bytes> struct SimdBitwise {
+  template<typename Op> static SIMD_INLINE void run(Op, uint64_t* out, const uint64_t* a, const uint64_t* b, size_t n){
+    typedef SimdVec<uint64_t, Bytes> S;
+    typedef typename S::V V;
+    const unsigned lanes = S::lanes;
+    size_t i = 0;
+    for(; n - i >= lanes; i += lanes){
+      V x = S::load(a + i);
+      V y = S::load(b + i);
+      Op::apply(x, y);
+      *(typename S::Unaligned*)(out + i) = x;
+    }
+    for(; i < n; i++){
+      uint64_t x = a[i];
+      Op::apply(x, b[i]);
+      out[i] = x;
+    }
+  }
+};
+
+//Number of set bits in the n words of w.
+//Each lane is counted with shifts, masks and adds (the classic parallel bit count), which every instruction set here has, unlike a vector popcount instruction.
+template<unsigned Bytes> struct SimdBitCount {
+  static SIMD_INLINE size_t run(const uint64_t* w, size_t n){
+    typedef SimdVec<uint64_t, Bytes> S;
+    typedef typename S::V V;
+    const unsigned lanes = S::lanes;
+    const uint64_t pairs = 0x5555555555555555ull, nibbles = 0x3333333333333333ull, bytes = 0x0f0f0f0f0f0f0f0full;
+    V total = {};
+    size_t i = 0;
+    for(; n - i >= lanes; i += lanes){
+      V x = S::load(w + i);
+      x = x - ((x >> 1) & pairs);
+      x = (x & nibbles) + ((x >> 2) & nibbles);
+      x = (x + (x >> 4)) & bytes;
+      x += x >> 8;
+      x += x >> 16;
+      x += x >> 32;
+      total += x & 0x7f;
+    }
+    size_t count = 0;
+    for(unsigned j = 0; j < lanes; j++){
+      count += total[j];
+    }
+    for(; i < n; i++){
+      for(uint64_t x = w[i]; x != 0; x &= x - 1){
+        count++;
+      }
+    }
+    return count;
+  }
+};
+
+#endif
+
+#endif
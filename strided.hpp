@@ -0,0 +1,275 @@
+//Strided and multidimensional views
+//Non-owning views of elements spaced a fixed distance apart (a column of a Matrix, every kth element, an array read backwards), and their N-dimensional extension with a shape and a stride per dimension.
+
+//Views never copy: element i of a StridedArray is data[i * stride].  Operations on a view with stride 1 forward to the contiguous Array loops.
+
+#ifndef STRIDED_H
+#define STRIDED_H
+
+#include <stddef.h>
+
+#include "array.hpp"
+
+template <typename T> struct StridedArray {
+  //Fields
+  ArraySize length;
+  T* data;
+  ptrdiff_t stride; //In elements, and may be negative.
+
+  //Constructors
+  StridedArray(T* data, ArraySize length, ptrdiff_t stride) : length(length), data(data), stride(stride) { }
+  StridedArray(const Array<T> arr) : length(arr.length), data(arr.data), stride(1) { }
+  StridedArray() : length(0), data(nullptr), stride(1) { }
+
+  //Accessors
+  T& operator[](ArraySize index) const {
+    VMATH_CHECK_BOUNDS(index < length);
+    return data[(ptrdiff_t)index * stride];
+  }
+
+  bool contiguous() const {
+    return stride == 1;
+  }
+
+  //The same elements as an Array.  Only for contiguous views.
+  Array<T> contiguousView() const {
+    VMATH_CHECK_CONTRACT(contiguous());
+    return Array<T>(data, length);
+  }
+
+  //Equality
+  bool operator==(const StridedArray<T>& other) const {
+    if(length != other.length) return false;
+    for(ArraySize i = 0; i < length; i++){
+      if(data[(ptrdiff_t)i * stride] != other.data[(ptrdiff_t)i * other.stride]) return false;
+    }
+    return true;
+  }
+  bool operator!=(const StridedArray<T>& other) const {
+    return !operator==(other);
+  }
+
+  //Functional Creators
+
+  //Gives a new view of [first, last)
+  StridedArray<T> slice(ArraySize first, ArraySize last) const {
+    VMATH_CHECK_BOUNDS(first <= last && last <= length);
+    return StridedArray<T>(data + (ptrdiff_t)first * stride, last - first, stride);
+  }
+
+  //Every kth element, starting with the first.
+  StridedArray<T> every(ArraySize k) const {
+    VMATH_CHECK_CONTRACT(k > 0);
+    return StridedArray<T>(data, (length + k - 1) / k, stride * (ptrdiff_t)k);
+  }
+
+  //The elements in reverse order.
+  StridedArray<T> reversed() const {
+    return StridedArray<T>((length == 0) ? data : data + (ptrdiff_t)(length - 1) * stride, length, -stride);
+  }
+
+  //Copies the elements into a new contiguous Array.
+  OwnedArray<T> materialize() const {
+    OwnedArray<T> out = OwnedArray<T>(length);
+    copyTo(out.data);
+    return out;
+  }
+
+  void copyTo(T* out) const {
+    if(contiguous()){
+      std::copy(data, data + length, out);
+      return;
+    }
+    for(ArraySize i = 0; i < length; i++){
+      out[i] = data[(ptrdiff_t)i * stride];
+    }
+  }
+
+  //Functional Operators, as on Array.
+
+  template<class F> auto map(F f) const -> OwnedArray<CallResult<F, T>>{
+    if(contiguous()) return contiguousView().map(f);
+    OwnedArray<CallResult<F, T>> out = OwnedArray<CallResult<F, T>>(length);
+    for(ArraySize i = 0; i < length; i++){
+      out.data[i] = f(data[(ptrdiff_t)i * stride]);
+    }
+    return out;
+  }
+
+  template<class F> void mapInPlace(F f) const {
+    if(contiguous()){
+      contiguousView().mapInPlace(f);
+      return;
+    }
+    for(ArraySize i = 0; i < length; i++){
+      data[(ptrdiff_t)i * stride] = f(data[(ptrdiff_t)i * stride]);
+    }
+  }
+
+  template<class F> void forEach(F f) const {
+    if(contiguous()){
+      contiguousView().forEach(f);
+      return;
+    }
+    for(ArraySize i = 0; i < length; i++){
+      f(data[(ptrdiff_t)i * stride]);
+    }
+  }
+
+  template<typename ResultTy, typename F> ResultTy fold(F f, ResultTy zero) const{
+    if(contiguous()) return contiguousView().fold(f, zero);
+    ResultTy acc = zero;
+    for(ArraySize i = 0; i < length; i++){
+      acc = f(acc, data[(ptrdiff_t)i * stride]);
+    }
+    return acc;
+  }
+
+  template<typename OtherTy, typename F> auto zip(const StridedArray<OtherTy> other, F f) const -> OwnedArray<CallResult<F, T, OtherTy>> {
+    VMATH_CHECK_BOUNDS(length == other.length); //Arrays must be identically sized.
+    if(contiguous() && other.contiguous()) return contiguousView().zip(other.contiguousView(), f);
+    OwnedArray<CallResult<F, T, OtherTy>> out = OwnedArray<CallResult<F, T, OtherTy>>(length);
+    for(ArraySize i = 0; i < length; i++){
+      out.data[i] = f(data[(ptrdiff_t)i * stride], other.data[(ptrdiff_t)i * other.stride]);
+    }
+    return out;
+  }
+  template<typename OtherTy, typename F> auto zip(const Array<OtherTy> other, F f) const -> OwnedArray<CallResult<F, T, OtherTy>> {
+    return zip(StridedArray<OtherTy>(other), f);
+  }
+};
+
+//Every kth element of arr, starting with the first.
+template <typename T> StridedArray<T> every(const Array<T> arr, ArraySize k){
+  return StridedArray<T>(arr).every(k);
+}
+
+template <typename T> std::ostream& operator<<(std::ostream& o, const StridedArray<T>& arr){
+  o << "{";
+  for(ArraySize i = 0; i < arr.length; i++){
+    o << ((i == 0) ? "" : ", ") << arr[i];
+  }
+  return o << "}";
+}
+
+//N-dimensional view: element (i0, ..., iN-1) is data[i0 * strides[0] + ... + iN-1 * strides[N - 1]].
+//Slicing, transposing and taking lanes only change the shape and strides, never the elements.
+template <typename T, unsigned N> struct NDView {
+  static_assert(N > 0, "A view needs at least one dimension.");
+
+  T* data;
+  ArraySize shape[N];
+  ptrdiff_t strides[N];
+
+  NDView() : data(nullptr) {
+    for(unsigned d = 0; d < N; d++){
+      shape[d] = 0;
+      strides[d] = 1;
+    }
+  }
+
+  //Row-major view of the elements of arr with the given shape, the last dimension varying fastest.
+  NDView(const Array<T> arr, const ArraySize (&shape)[N]) : data(arr.data) {
+    ptrdiff_t stride = 1;
+    for(unsigned d = N; d-- > 0;){
+      this->shape[d] = shape[d];
+      strides[d] = stride;
+      stride *= shape[d];
+    }
+    VMATH_CHECK_BOUNDS((size_t)stride == arr.length); //The shape must cover the Array exactly.
+  }
+
+  NDView(T* data, const ArraySize (&shape)[N], const ptrdiff_t (&strides)[N]) : data(data) {
+    for(unsigned d = 0; d < N; d++){
+      this->shape[d] = shape[d];
+      this->strides[d] = strides[d];
+    }
+  }
+
+  //Accessors
+  template<typename... Idx> T& operator()(Idx... idx) const {
+    static_assert(sizeof...(Idx) == N, "One index per dimension.");
+    const ArraySize index[N] = {(ArraySize)idx...};
+    ptrdiff_t offset = 0;
+    for(unsigned d = 0; d < N; d++){
+      VMATH_CHECK_BOUNDS(index[d] < shape[d]);
+      offset += (ptrdiff_t)index[d] * strides[d];
+    }
+    return data[offset];
+  }
+
+  size_t size() const {
+    size_t n = 1;
+    for(unsigned d = 0; d < N; d++){
+      n *= shape[d];
+    }
+    return n;
+  }
+
+  //The view with dimension axis fixed at index, which has one dimension less.
+  NDView<T, N - 1> slice(unsigned axis, ArraySize index) const {
+    static_assert(N > 1, "Slicing a one dimensional view gives an element; use lane or operator().");
+    VMATH_CHECK_BOUNDS(axis < N && index < shape[axis]);
+    NDView<T, N - 1> out;
+    out.data = data + (ptrdiff_t)index * strides[axis];
+    for(unsigned d = 0, o = 0; d < N; d++){
+      if(d == axis) continue;
+      out.shape[o] = shape[d];
+      out.strides[o] = strides[d];
+      o++;
+    }
+    return out;
+  }
+
+  //The view with dimensions a and b swapped.
+  NDView<T, N> transpose(unsigned a, unsigned b) const {
+    VMATH_CHECK_BOUNDS(a < N && b < N);
+    NDView<T, N> out = *this;
+    std::swap(out.shape[a], out.shape[b]);
+    std::swap(out.strides[a], out.strides[b]);
+    return out;
+  }
+
+  //The elements along dimension axis through the position at (whose entry for axis is ignored), as a StridedArray.
+  StridedArray<T> lane(unsigned axis, const ArraySize (&at)[N]) const {
+    VMATH_CHECK_BOUNDS(axis < N);
+    ptrdiff_t offset = 0;
+    for(unsigned d = 0; d < N; d++){
+      if(d == axis) continue;
+      VMATH_CHECK_BOUNDS(at[d] < shape[d]);
+      offset += (ptrdiff_t)at[d] * strides[d];
+    }
+    return StridedArray<T>(data + offset, shape[axis], strides[axis]);
+  }
+
+  //Calls f on each element in row-major order.  The last dimension is walked as a StridedArray, so contiguous rows take the Array loop.
+  template<class F> void forEach(F f) const {
+    if(size() == 0) return;
+    ArraySize index[N] = {};
+    while(true){
+      lane(N - 1, index).forEach(f);
+      unsigned d = N - 1;
+      while(d-- > 0){
+        if(++index[d] < shape[d]) break;
+        index[d] = 0;
+      }
+      if(d == (unsigned)-1) return;
+    }
+  }
+
+  template<typename ResultTy, typename F> ResultTy fold(F f, ResultTy zero) const {
+    ResultTy acc = zero;
+    forEach([&acc, &f](const T& t){acc = f(acc, t);});
+    return acc;
+  }
+
+  //Copies the elements into a new contiguous Array in row-major order.
+  OwnedArray<T> materialize() const {
+    OwnedArray<T> out = OwnedArray<T>(size());
+    T* p = out.data;
+    forEach([&p](const T& t){*p++ = t;});
+    return out;
+  }
+};
+
+#endif
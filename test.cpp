@@ -2,6 +2,13 @@
 #include <cmath>
 #include "array.hpp"
 #include "vectormath.hpp"
+#include "lazy.hpp"
+#include "arrayfile.hpp"
+#include "textio.hpp"
+#include <sstream>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 Array<int> count(unsigned count){
   int* data = new int[count];
@@ -15,11 +22,36 @@ bool testMap(){
 	Array<int> testArr = count(5);
 	int should[5] = {0,1,4,9,16};
 	Array<int> shouldArr(should, 5);
- 	Array<int> newArr = testArr.map<int>([](int v){return v * v;});
+ 	OwnedArray<int> newArr = testArr.map<int>([](int v){return v * v;});
 
 	return shouldArr == newArr;
 }
 
+//Most elements are cheap, a few cost thousands of times more.
+int skewedCalculation(int i){
+	int iterations = (i % 997 == 0) ? 20000 : 5;
+	unsigned h = i;
+	for(int k = 0; k < iterations; k++){
+		h = h * 2654435761u + 1;
+	}
+	return (int)(h >> 8);
+}
+
+bool testMapDynamic(){
+	OwnedArray<int> testArr = OwnedArray<int>::adopt(count(50000));
+	OwnedArray<int> should = testArr.map(skewedCalculation);
+	bool ok = testArr.mapParallel(skewedCalculation) == should;
+	unsigned grains[4] = {1, 7, 1000, 100000};
+	for(unsigned g = 0; g < 4; g++){
+		ok = ok && testArr.mapParallel(skewedCalculation, DynamicPolicy(grains[g])) == should;
+	}
+	//Cheap maps, small and empty arrays.
+	OwnedArray<int> small = OwnedArray<int>::adopt(count(3));
+	ok = ok && small.mapParallel<double>([](int v){return v * 0.5;})[2] == 1.0;
+	ok = ok && OwnedArray<int>().mapParallel([](int v){return v;}).length == 0;
+	return ok;
+}
+
 int expensiveCalculation(int i){
 	return (int)(sqrt(i * i + i) / i);
 }
@@ -32,21 +64,50 @@ bool testMapParallel(){
 		should[i] = expensiveCalculation(i);
 	}
 	Array<int> shouldArr(should, PCOUNT);
- 	Array<int> newArr = testArr.mapParallel<int>([](int v){return expensiveCalculation(v);});
+ 	OwnedArray<int> newArr = testArr.mapParallel<int>([](int v){return expensiveCalculation(v);});
 
 	return shouldArr == newArr;
 }
 
+bool testThreadPool(){
+	ThreadPool pool(3);
+	Array<int> hits = Array<int>(1000, 0);
+	for(unsigned rep = 0; rep < 100; rep++){
+		pool.run(hits.length, [hits](unsigned i){hits[i]++;});
+	}
+	pool.resize(1);
+	pool.run(hits.length, [hits](unsigned i){hits[i]++;});
+	bool ok = hits.conjunction([](int v){return v == 101;});
+	hits.freeMemory();
+	return ok;
+}
+
 bool testFilter(){
 	int test[5] = {0,1,2,3,4};
 	int should[2] = {1,3};
 	Array<int> testArr(test, 5);
 	Array<int> shouldArr(should, 2);
-	Array<int> newArr = testArr.filter([](int v){return v % 2 == 1;});
+	OwnedArray<int> newArr = testArr.filter([](int v){return v % 2 == 1;});
 
 	return shouldArr == newArr;
 }
 
+bool testFilterParallel(){
+	Array<int> testArr = count(100000);
+	OwnedArray<int> should = testArr.filter([](int v){return v % 7 == 3;});
+	OwnedArray<int> par = testArr.filterParallel([](int v){return v % 7 == 3;}, 6, 0);
+	OwnedArray<int> parCl = testArr.filterParallel<int>([](int v, int cl){return v % 7 == cl;}, 3);
+	OwnedArray<int> none = testArr.filterParallel([](int v){return v < 0;});
+	
+	bool ok = should == par && should == parCl && none.length == 0;
+	testArr.freeMemory();
+	should.freeMemory();
+	par.freeMemory();
+	parCl.freeMemory();
+	none.freeMemory();
+	return ok;
+}
+
 bool testPredicates(){
 	int test[5] = {1, 3, 5, 7};
 	Array<int> testArr(test, 4);
@@ -89,11 +150,834 @@ bool testZip(){
   Array<double> test1 = Array<double>(10, 1);
   double cl = .5;
   
-  Array<float> result = test0.zip<double, float, double>(test1, [](int a, double b, double cl){return (float) (a * b * cl);}, cl);
+  OwnedArray<float> result = test0.zip<double, float, double>(test1, [](int a, double b, double cl){return (float) (a * b * cl);}, cl);
   
   return result.conjunction([](float val){return val == 1;});
 }
 
+int negate(const int v){
+	return -v;
+}
+
+struct Affine {
+	int a, b;
+	int operator()(int v) const {return a * v + b;}
+};
+
+bool testCallables(){
+	Array<int> arr = count(100);
+	int offset = 3;
+	
+	OwnedArray<int> shifted = arr.map([offset](int v){return v + offset;});
+	OwnedArray<int> affine = arr.map(Affine{2, 1});
+	OwnedArray<int> negated = arr.map(&negate);
+	OwnedArray<double> halves = arr.zip(shifted, [](int a, int b){return (a + b) / 2.0;});
+	OwnedArray<int> big = arr.filter([offset](int v){return v >= 100 - offset;});
+	long long sum = arr.fold([offset](long long acc, int v){return acc + v * offset;}, 0LL);
+	int total = 0;
+	arr.forEach([&total](int& v){total += v;});
+	
+	bool ok = shifted[10] == 13
+	   &&  affine[10] == 21
+	   &&  negated[10] == -10
+	   &&  halves[10] == 11.5
+	   &&  big.length == 3
+	   &&  sum == 3 * 4950
+	   &&  total == 4950
+	   &&  arr.conjunction([offset](int v){return v < 100 + offset;})
+	   && !arr.disjunction(Affine{0, 0});
+	
+	arr.freeMemory();
+	shifted.freeMemory();
+	affine.freeMemory();
+	negated.freeMemory();
+	halves.freeMemory();
+	big.freeMemory();
+	return ok;
+}
+
+bool testLazy(){
+	Array<int> a = count(1000);
+	Array<int> b = count(1000);
+	int k = 3;
+	
+	OwnedArray<int> squares = a.map([](int v){return v * v;});
+	OwnedArray<int> sums = squares.zip(b, [k](int x, int y){return x + k * y;});
+	OwnedArray<int> selected = sums.filter([](int v){return v % 3 == 1;});
+	
+	OwnedArray<int> fused = lazy(a).map([](int v){return v * v;}).zip(b, [k](int x, int y){return x + k * y;}).filter([](int v){return v % 3 == 1;}).materialize();
+	OwnedArray<int> window = lazy(a).drop(10).map([](int v){return v * 2;}).take(5).materialize();
+	OwnedArray<int> someSelected = lazy(sums).filter([](int v){return v % 3 == 1;}).drop(2).take(3).materialize();
+	long long total = lazy(a).zip(lazy(b).map([](int v){return -v;}), [](int x, int y){return x + y;}).fold([](long long acc, int v){return acc + v;}, 0LL);
+	int oddSum = lazy(a).filter([](int v){return v % 2 == 1;}).sumTerms();
+	
+	bool ok = fused == selected
+	   &&  window.length == 5 && window[0] == 20 && window[4] == 28
+	   &&  someSelected.length == 3 && someSelected[0] == selected[2] && someSelected[2] == selected[4]
+	   &&  total == 0
+	   &&  oddSum == 250000;
+	
+	a.freeMemory();
+	b.freeMemory();
+	squares.freeMemory();
+	sums.freeMemory();
+	selected.freeMemory();
+	fused.freeMemory();
+	window.freeMemory();
+	someSelected.freeMemory();
+	return ok;
+}
+
+//Counts its live instances, so a test can tell that every element made was destroyed.
+struct Counted {
+  static int live;
+  int v;
+  
+  Counted(int v = 0) : v(v) { live++; }
+  Counted(const Counted& o) : v(o.v) { live++; }
+  Counted& operator=(const Counted& o) = default;
+  ~Counted(){ live--; }
+  Counted& operator+=(const Counted& o){
+    v += o.v;
+    return *this;
+  }
+};
+int Counted::live = 0;
+
+template<typename T> ArraySize viewLength(Array<T> arr){
+  return arr.length;
+}
+
+bool testOwnedArray(){
+  Array<int> arr = count(10);
+  
+  //Allocating operations return owning arrays, which free themselves.
+  OwnedArray<int> squares = arr.map([](int v){return v * v;});
+  OwnedArray<int> moved = std::move(squares);
+  OwnedArray<int> copy = arrayCopy(arr);
+  OwnedArray<int> cloned = moved.clone();
+  cloned[1] = 100;
+  
+  //Owning arrays are views too.
+  bool ok = squares.data == nullptr
+     &&  moved[3] == 9 && cloned[3] == 9 && moved[1] == 1
+     &&  sumTerms(moved) == 285
+     &&  copy == arr
+     &&  moved.view().take(3).conjunction([](int v){return v < 5;});
+  
+  //A plain Array takes over a result's memory only when asked to.
+  Array<int> plain = arr.filter([](int v){return v > 5;}).release();
+  ok = ok && plain.length == 4 && plain[0] == 6;
+  plain.freeMemory();
+  
+  moved = arr.zip(arr, [](int a, int b){return a - b;});
+  ok = ok && moved.length == 10 && moved.conjunction([](int v){return v == 0;});
+  
+  //Temporaries passed to Array parameters are only viewed, and freed at the end of the expression.
+  auto toCounted = [](int v){return Counted(v);};
+  ok = ok && viewLength(arr.map(toCounted)) == 10;
+  ok = ok && sumTerms(arr.map(toCounted)).v == 45;
+  ok = ok && lazy(arr.map(toCounted)).take(3).materialize().length == 3;
+  ok = ok && Counted::live == 0;
+  Array<Counted> taken(arr.map(toCounted));
+  ok = ok && taken.length == 10 && Counted::live == 10;
+  taken.freeMemory();
+  ok = ok && Counted::live == 0;
+  
+  arr.freeMemory();
+  return ok;
+}
+
+bool testAllocators(){
+  Array<int> arr = count(1000);
+  ArenaAllocator arena(4096);
+  PoolAllocator pool;
+  bool ok = true;
+  
+  for(unsigned request = 0; request < 3; request++){
+    {
+      ArrayAllocatorScope scope(arena);
+      OwnedArray<int> doubled = arr.map([](int v){return v * 2;});
+      OwnedArray<int> big = doubled.filter([](int v){return v >= 1000;});
+      OwnedArray<double> halves = big.zip(big, [](int a, int b){return (a + b) / 4.0;});
+      ok = ok && doubled.allocator == &arena && big.length == 500 && halves[0] == 500;
+      
+      //Plain Arrays still own new [] memory they can free.
+      OwnedArray<int> plain = arr.map([](int v){return v + 1;});
+      ok = ok && plain[0] == 1;
+      plain.freeMemory();
+    }
+    ok = ok && arena.capacity() <= 4 * 4096 * 4;
+    arena.reset();
+  }
+  
+  {
+    ArrayAllocatorScope scope(pool);
+    int* first;
+    {
+      OwnedArray<int> a = OwnedArray<int>(100, 7);
+      first = a.data;
+    }
+    OwnedArray<int> b = OwnedArray<int>(120); //Same size class, so the block is recycled.
+    ok = ok && b.data == first && b.allocator == &pool;
+  }
+  OwnedArray<int> outside = OwnedArray<int>(10);
+  ok = ok && outside.allocator == nullptr;
+  
+  arr.freeMemory();
+  return ok;
+}
+
+bool testArrayFile(){
+  //A fresh file per run, so concurrent runs and other users' leftovers do not interfere.
+  char path[] = "/tmp/vmath_test_array_XXXXXX";
+  int fd = mkstemp(path);
+  if(fd < 0) return false;
+  close(fd);
+  OwnedArray<int> indices = OwnedArray<int>::adopt(count(1000));
+  OwnedArray<double> arr = indices.map([](int v){return v * 0.5;});
+  bool ok = writeArrayFile(path, arr);
+  
+  {
+    MappedArray<double> mapped(path);
+    ok = ok && mapped.isOpen() && mapped == arr && ((uintptr_t)mapped.data % ARRAY_FILE_ALIGNMENT) == 0;
+    
+    MappedArray<double> cow(path, MAP_COPY_ON_WRITE);
+    cow[3] = -1;
+    ok = ok && cow[3] == -1 && mapped[3] == 1.5;
+    
+    MappedArray<double> moved = std::move(cow);
+    ok = ok && !cow.isOpen() && moved.length == 1000;
+  }
+  MappedArray<double> reopened(path);
+  ok = ok && reopened[3] == 1.5; //Copy on write changes never reach the file.
+  
+  //Mismatched element types and missing files give empty, unopened arrays.
+  MappedArray<float> wrongType(path);
+  MappedArray<double> missing((std::string(path) + ".missing").c_str());
+  ok = ok && !wrongType.isOpen() && wrongType.length == 0 && !missing.isOpen();
+  
+  //Types are matched by size and signedness, so the standard integer types are written and read as their fixed width equivalents.
+  OwnedArray<long long> longs = indices.map([](int v){return (long long)v * -3000000000ll;});
+  ok = ok && writeArrayFile(path, longs);
+  MappedArray<long long> mappedLongs(path);
+  MappedArray<int64_t> asInt64(path);
+  ok = ok && mappedLongs == longs && asInt64.isOpen() && asInt64[7] == -21000000000ll;
+  OwnedArray<unsigned long> ulongs = indices.map([](int v){return (unsigned long)v;});
+  ok = ok && writeArrayFile(path, ulongs) && MappedArray<unsigned long>(path) == ulongs && !MappedArray<long>(path).isOpen();
+  OwnedArray<char> chars = indices.map([](int v){return (char)('a' + v % 26);});
+  ok = ok && writeArrayFile(path, chars) && MappedArray<char>(path) == chars;
+  ok = ok && MappedArray<typename std::conditional<std::is_signed<char>::value, int8_t, uint8_t>::type>(path).isOpen();
+  
+  OwnedArray<int> empty = OwnedArray<int>(0);
+  ok = ok && writeArrayFile(path, empty);
+  MappedArray<int> mappedEmpty(path);
+  ok = ok && mappedEmpty.isOpen() && mappedEmpty.length == 0;
+  
+  remove(path);
+  return ok;
+}
+
+bool testTextIO(){
+  bool ok = true;
+  OwnedArray<int> indices = OwnedArray<int>::adopt(count(50000));
+  OwnedArray<int> ints = indices.map([](int v){return (v % 7 == 0) ? -v : v * 3;});
+  OwnedArray<double> doubles = indices.map([](int v){return std::sin(v) * 1e5 / (v + 1);});
+  
+  //The braced layout matches writeToStream, and the parallel and serial writers agree.
+  std::ostringstream expected, serial, parallel;
+  ints.writeToStream(expected);
+  writeBracedText(serial, ints, 1);
+  writeBracedText(parallel, ints, 3, 0);
+  ok = ok && serial.str() == expected.str() && parallel.str() == expected.str();
+  
+  OwnedArray<int> intsBack;
+  std::istringstream intsIn(parallel.str());
+  ok = ok && readBracedText(intsIn, intsBack) && intsBack == ints;
+  
+  //Doubles round-trip exactly in both layouts.
+  std::ostringstream bracedDoubles, lines;
+  writeBracedText(bracedDoubles, doubles, 3, 0);
+  writeDelimitedText(lines, doubles, '\n', 3, 0);
+  OwnedArray<double> fromBraced, fromLines;
+  std::istringstream bracedIn(bracedDoubles.str()), linesIn(lines.str());
+  ok = ok && readBracedText(bracedIn, fromBraced) && fromBraced == doubles;
+  ok = ok && readDelimitedText(linesIn, fromLines, '\n') && fromLines == doubles;
+  
+  //Delimited parsing tolerates whitespace and rejects malformed text.
+  OwnedArray<float> parsed;
+  const char* csv = " 1.5, -2 ,+3e2\n4 ";
+  ok = ok && parseDelimitedText(csv, csv + strlen(csv), parsed) && parsed.length == 4 && parsed[2] == 300 && parsed[3] == 4;
+  const char* bad[] = {"1,,2", "1,", "1 2x", "{1, 2", "{1 2}", "{}x", "+-5", "{+-5}", "1,++2"};
+  for(unsigned i = 0; i < 9; i++){
+    const char* end = bad[i] + strlen(bad[i]);
+    ok = ok && !(bad[i][0] == '{' ? parseBracedText(bad[i], end, parsed) : parseDelimitedText(bad[i], end, parsed));
+    std::istringstream badIn(bad[i]);
+    ok = ok && !(bad[i][0] == '{' ? readBracedText(badIn, parsed) : readDelimitedText(badIn, parsed));
+  }
+  ok = ok && parsed.length == 4;
+  
+  //Streams are read a buffer at a time, with elements split across refills and even ones longer than the buffer.
+  std::string longText = "{7, " + std::string(TEXT_BUFFER_SIZE + 10, '0') + "5 , -3}";
+  std::istringstream longIn(longText), longBadIn(longText.substr(0, longText.size() - 1));
+  OwnedArray<int> longBack;
+  ok = ok && readBracedText(longIn, longBack) && longBack.length == 3 && longBack[1] == 5 && longBack[2] == -3;
+  ok = ok && !readBracedText(longBadIn, longBack) && longBack.length == 3;
+  std::ostringstream spaced;
+  for(unsigned i = 0; i < 40000; i++) spaced << (i % 5 == 0 ? "\n  " : " , ") << i;
+  std::istringstream spacedIn(spaced.str().substr(3)); //No leading delimiter.
+  OwnedArray<unsigned> spacedBack;
+  ok = ok && readDelimitedText(spacedIn, spacedBack) && spacedBack.length == 40000 && spacedBack[39999] == 39999 && spacedBack[12345] == 12345;
+  
+  std::ostringstream emptyOut;
+  writeBracedText(emptyOut, OwnedArray<int>(0).view());
+  std::istringstream emptyIn("{}\n");
+  OwnedArray<int> empty = OwnedArray<int>(3);
+  ok = ok && emptyOut.str() == "{}" && readBracedText(emptyIn, empty) && empty.length == 0;
+  return ok;
+}
+
+template <typename T> bool checkSorts(OwnedArray<T>& input){
+  OwnedArray<T> expected = input.clone();
+  expected.sort();
+  bool ok = true;
+  for(unsigned pc = 1; pc <= 5; pc++){
+    OwnedArray<T> parallel = input.clone();
+    parallel.sort(ParallelPolicy(pc, 0));
+    OwnedArray<T> radix = input.clone();
+    radix.radixSort(ParallelPolicy(pc, 0));
+    ok = ok && parallel == expected && radix == expected;
+  }
+  OwnedArray<T> serialRadix = input.clone();
+  serialRadix.radixSort();
+  return ok && serialRadix == expected;
+}
+
+bool testSort(){
+  std::mt19937 gen(7);
+  bool ok = true;
+  unsigned lengths[] = {0, 1, 2, 100, 30001};
+  for(unsigned l = 0; l < 5; l++){
+    unsigned n = lengths[l];
+    OwnedArray<int> ints = OwnedArray<int>(n);
+    OwnedArray<unsigned char> bytes = OwnedArray<unsigned char>(n);
+    OwnedArray<long> longs = OwnedArray<long>(n);
+    OwnedArray<double> doubles = OwnedArray<double>(n);
+    OwnedArray<float> floats = OwnedArray<float>(n);
+    for(unsigned i = 0; i < n; i++){
+      ints[i] = (int)gen() % 1000; //Many duplicates, and negative values.
+      bytes[i] = gen();
+      longs[i] = (long)(((unsigned long)gen() << 32) | gen());
+      doubles[i] = std::ldexp((double)gen() - 2147483648.0, (int)(gen() % 64) - 32);
+      floats[i] = (i % 5 == 0) ? -(float)(gen() % 10) : (float)gen() / 7; //Includes both zeros, which compare equal.
+    }
+    ok = ok && checkSorts(ints) && checkSorts(bytes) && checkSorts(longs) && checkSorts(doubles);
+    OwnedArray<float> radixFloats = floats.clone();
+    radixFloats.radixSort(ParallelPolicy(3, 0));
+    floats.sort();
+    ok = ok && radixFloats == floats; //-0 == 0, so the two orders compare equal.
+  }
+  
+  return ok;
+}
+
+bool testParallelShuffle(){
+  const unsigned n = 20000;
+  OwnedArray<int> base = OwnedArray<int>::adopt(count(n));
+  bool ok = true;
+  for(unsigned pc = 1; pc <= 4; pc++){
+    OwnedArray<int> a = base.clone(), b = base.clone(), c = base.clone();
+    a.shuffle(42, ParallelPolicy(pc, 0));
+    b.shuffle(42, ParallelPolicy(pc, 0));
+    c.shuffle(43, ParallelPolicy(pc, 0));
+    ok = ok && a == b && a != c && a != base; //Reproducible for a given seed and partition count.
+    a.sort();
+    ok = ok && a == base; //A permutation.
+  }
+  
+  //Every element is about equally likely to land in each position.
+  const unsigned small = 6, trials = 24000;
+  unsigned hits[small][small] = {};
+  OwnedArray<int> s = OwnedArray<int>(small);
+  for(unsigned t = 0; t < trials; t++){
+    for(unsigned i = 0; i < small; i++) s[i] = i;
+    s.shuffle(t, ParallelPolicy(3, 0));
+    for(unsigned i = 0; i < small; i++) hits[s[i]][i]++;
+  }
+  for(unsigned v = 0; v < small; v++){
+    for(unsigned i = 0; i < small; i++){
+      ok = ok && std::abs((int)hits[v][i] - (int)(trials / small)) < 250;
+    }
+  }
+  return ok;
+}
+
+template <typename T> bool checkExtremes(unsigned level){
+#ifdef VMATH_SIMD
+  simdLevelLimit() = (SimdLevel)level;
+#endif
+  std::mt19937 gen(3);
+  bool ok = true;
+  for(unsigned n = 1; n < 300; n += 7){
+    std::vector<T> v(n);
+    for(unsigned i = 0; i < n; i++) v[i] = (T)(gen() % 50) - 25; //Many ties.
+    if(n > 100) v[n - 1] = 1000;
+    unsigned maxExpected = std::max_element(v.begin(), v.end()) - v.begin();
+    unsigned minExpected = std::min_element(v.begin(), v.end()) - v.begin();
+    Array<T> arr(v.data(), n);
+    ok = ok && maxIndex(arr) == maxExpected && minIndex(arr) == minExpected;
+    ok = ok && maxIndex(arr, ParallelPolicy(3, 0)) == maxExpected && minIndex(arr, ParallelPolicy(4, 0)) == minExpected;
+    ok = ok && max(arr) == v[maxExpected] && min(arr) == v[minExpected];
+  }
+  //NaNs are passed over, as in the scalar loop.
+  T withNan[40];
+  for(unsigned i = 0; i < 40; i++) withNan[i] = i % 9;
+  withNan[17] = NAN;
+  ok = ok && maxIndex(withNan, 40) == 8 && minIndex(withNan, 40) == 0;
+  withNan[0] = NAN;
+  ok = ok && maxIndex(withNan, 40) == 0;
+#ifdef VMATH_SIMD
+  simdLevelLimit() = SIMD_AVX512;
+#endif
+  return ok;
+}
+
+bool testExtremes(){
+  bool ok = true;
+  for(unsigned level = 0; level < 3; level++){
+    ok = ok && checkExtremes<float>(level) && checkExtremes<double>(level);
+  }
+  
+  int ints[] = {3, 9, 1, 9, -4, 7, 1};
+  ok = ok && maxUniqueIndex(ints, 7) == (ArraySize)-1 && maxUniqueIndex(ints, 3) == 1 && minIndex(Array<int>(ints, 7)) == 4;
+  //Ties are reported as the ArraySize negation of the first maximal index.
+  double tied[] = {1, 0, 2, 8, 5, 8, 8};
+  ArraySize r = maxUniqueIndex(tied, 7);
+  ok = ok && r == (ArraySize)0 - 3 && r >= 7 && (ArraySize)0 - r == 3 && maxUniqueIndex(tied, 5) == 3;
+  
+  //Top and bottom k agree with a stable sort, serially and in parallel.
+  std::mt19937 gen(5);
+  OwnedArray<int> values = OwnedArray<int>(5000);
+  for(unsigned i = 0; i < values.length; i++) values[i] = gen() % 400;
+  std::vector<unsigned> order(values.length);
+  for(unsigned i = 0; i < values.length; i++) order[i] = i;
+  std::stable_sort(order.begin(), order.end(), [&](unsigned a, unsigned b){return values[a] > values[b];});
+  unsigned ks[] = {1, 10, 5000};
+  for(unsigned t = 0; t < 3; t++){
+    unsigned k = ks[t];
+    for(unsigned pc = 1; pc <= 3; pc++){
+      OwnedArray<ArraySize> indices = OwnedArray<ArraySize>(k);
+      OwnedArray<int> best = OwnedArray<int>(k);
+      topK(indices, best, values, ParallelPolicy(pc, 0));
+      for(unsigned i = 0; i < k; i++){
+        ok = ok && indices[i] == order[i] && best[i] == values[order[i]];
+      }
+      bottomK(indices, best, values, ParallelPolicy(pc, 0));
+      for(unsigned i = 0; i < k; i++){
+        ok = ok && best[i] == values[order[values.length - 1 - i]] && (i == 0 || best[i - 1] < best[i] || indices[i - 1] < indices[i]);
+      }
+    }
+  }
+  return ok;
+}
+
+template <typename T> bool checkReductions(){
+  std::mt19937 gen(11);
+  bool ok = true;
+  unsigned lengths[] = {0, 3, 100, 5000, 70001};
+  for(unsigned l = 0; l < 5; l++){
+    unsigned n = lengths[l];
+    OwnedArray<T> v = OwnedArray<T>(n);
+    OwnedArray<T> nearOne = OwnedArray<T>(n);
+    OwnedArray<T> probs = OwnedArray<T>(n);
+    long double sum = 0, abs = 0, squares = 0, inf = 0, product = 1, total = 0;
+    for(unsigned i = 0; i < n; i++){
+      v[i] = (T)((double)gen() / 4294967296.0 - 0.3);
+      nearOne[i] = (T)(1 + ((double)gen() / 4294967296.0 - 0.5) / n);
+      probs[i] = (T)(gen() % 100);
+      sum += v[i];
+      abs += std::fabs(v[i]);
+      squares += (long double)v[i] * v[i];
+      inf = std::max(inf, (long double)std::fabs(v[i]));
+      product *= nearOne[i];
+      total += probs[i];
+    }
+    //NaNs are skipped by lInfNorm whatever the policy, wherever they fall.
+    OwnedArray<T> withNan = OwnedArray<T>(n);
+    long double infNan = 0;
+    for(unsigned i = 0; i < n; i++){
+      withNan[i] = (i == 0 || i == n / 2 || i == n - 1) ? std::numeric_limits<T>::quiet_NaN() : v[i];
+      if(withNan[i] == withNan[i]) infNan = std::max(infNan, (long double)std::fabs(v[i]));
+    }
+    long double ent = 0;
+    for(unsigned i = 0; i < n; i++){
+      probs[i] = (T)(probs[i] / total);
+      if(probs[i] > 0) ent -= probs[i] * std::log((long double)probs[i]);
+    }
+    ent /= std::log(2.0L);
+    const double tol = std::is_same<T, float>::value ? 1e-4 : 1e-10;
+    auto close = [tol](long double a, long double b){return std::fabs((double)(a - b)) <= tol * (1 + std::fabs((double)b));};
+    for(unsigned level = 0; level < 3; level++){
+#ifdef VMATH_SIMD
+      simdLevelLimit() = (SimdLevel)level;
+#endif
+      ok = ok && close(sumTerms(v, VectorizedPolicy()), sum) && close(sumTerms(v, ParallelPolicy(3, 0)), sum) && close(sumTerms(v, SequentialPolicy()), sum);
+      //Every float multiplication near 1 can lose half an ulp, so long float products drift whatever the order.
+      const double productTol = std::is_same<T, float>::value ? 1e-3 : 1e-10;
+      ok = ok && std::fabs((double)(productTerms(nearOne, VectorizedPolicy()) - product)) < productTol && std::fabs((double)(productTerms(nearOne, ParallelPolicy(4, 0)) - product)) < productTol;
+      ok = ok && close(l1Norm(v, VectorizedPolicy()), abs) && close(l1Norm(v, ParallelPolicy(2, 0)), abs) && close(l1Norm(v), abs);
+      ok = ok && close(l2Norm(v, VectorizedPolicy()), std::sqrt(squares)) && close(l2Norm(v, ParallelPolicy(3, 0)), std::sqrt(squares)) && close(l2Norm(v), std::sqrt(squares));
+      ok = ok && lInfNorm(v, VectorizedPolicy()) == (T)inf && lInfNorm(v, ParallelPolicy(3, 0)) == (T)inf && lInfNorm(v) == (T)inf;
+      ok = ok && lInfNorm(withNan, VectorizedPolicy()) == (T)infNan && lInfNorm(withNan, ParallelPolicy(3, 0)) == (T)infNan && lInfNorm(withNan, SequentialPolicy()) == (T)infNan && lInfNorm(withNan) == (T)infNan;
+      if(n > 0){
+        ok = ok && close(entropy(probs, VectorizedPolicy()), ent) && close(entropy(probs, ParallelPolicy(3, 0)), ent);
+      }
+    }
+#ifdef VMATH_SIMD
+    simdLevelLimit() = SIMD_AVX512;
+#endif
+  }
+  return ok;
+}
+
+bool testReductions(){
+  int ints[] = {4, -2, 7, 1, -9};
+  return checkReductions<float>() && checkReductions<double>()
+      && sumTerms(ints, 5, VectorizedPolicy()) == 1 && l1Norm(ints, 5, ParallelPolicy(2, 0)) == 23 && lInfNorm(Array<int>(ints, 5), SequentialPolicy()) == 9 && productTerms(ints, 5, VectorizedPolicy()) == 504;
+}
+
+template <typename T> bool checkEntropy(){
+  std::mt19937 gen(13);
+  bool ok = true;
+  const double bound = std::is_same<T, float>::value ? 2e-7 : 4e-16;
+  unsigned lengths[] = {1, 7, 33, 1000, 40000};
+  for(unsigned l = 0; l < 5; l++){
+    unsigned n = lengths[l];
+    OwnedArray<T> p = OwnedArray<T>(n);
+    long double total = 0;
+    for(unsigned i = 0; i < n; i++){
+      p[i] = (i % 3 == 1) ? 0 : (T)std::ldexp(1.0 + gen() % 1000, -(int)(gen() % 30)); //Zeros and a wide range of magnitudes.
+      total += p[i];
+    }
+    long double exact = 0;
+    for(unsigned i = 0; i < n; i++){
+      p[i] = (T)(p[i] / total);
+      if(p[i] > 0) exact -= p[i] * std::log((long double)p[i]);
+    }
+    //Approximation error plus summation rounding (relative, of the size of the sums).
+    const double tol = bound * (1 + (double)exact) + (std::is_same<T, float>::value ? 1e-5 : 1e-12);
+    for(unsigned level = 0; level < 3; level++){
+#ifdef VMATH_SIMD
+      simdLevelLimit() = (SimdLevel)level;
+#endif
+      double fast = entropy(p, VectorizedPolicy()) * LN_2;
+      double fastParallel = entropy(p, ParallelPolicy(3, 0)) * LN_2;
+      double exactParallel = entropy(p, ParallelPolicy(3, 0), LOG_EXACT) * LN_2;
+      ok = ok && std::fabs(fast - (double)exact) < tol && std::fabs(fastParallel - (double)exact) < tol && std::fabs(exactParallel - (double)exact) < tol;
+    }
+#ifdef VMATH_SIMD
+    simdLevelLimit() = SIMD_AVX512;
+#endif
+    ok = ok && std::fabs(entropy(p) * LN_2 - (double)exact) < tol;
+  }
+  
+  //Strictly positive uniform distributions have entropy log2(n).
+  OwnedArray<T> uniform = OwnedArray<T>(1024, (T)1 / 1024);
+  ok = ok && std::fabs(entropyStrictPositive(uniform, VectorizedPolicy()) - 10) < 1e-4 && std::fabs(entropyStrictPositive(uniform) - 10) < 1e-4;
+  return ok;
+}
+
+bool testEntropy(){
+  return checkEntropy<float>() && checkEntropy<double>();
+}
+
+bool testMatrix(){
+  const unsigned rows = 1000, cols = 150;
+  Matrix<double> m(rows, cols);
+  std::mt19937 gen(17);
+  for(unsigned i = 0; i < rows; i++){
+    for(unsigned j = 0; j < cols; j++){
+      m(i, j) = 1e6 * (j % 3) + (double)(gen() % 10000) / 100; //Large offsets in some columns.
+    }
+  }
+  bool ok = m.row(3).length == cols && &m.row(3)[0] == &m(3, 0) && m.rowRange(2, 5).length == 3 * cols;
+  
+  OwnedArray<double> column = OwnedArray<double>(rows);
+  OwnedArray<double> means = OwnedArray<double>(cols), variances = OwnedArray<double>(cols), mins = OwnedArray<double>(cols), maxes = OwnedArray<double>(cols);
+  for(unsigned pc = 1; pc <= 3; pc++){
+    ParallelPolicy policy(pc, 0);
+    OwnedArray<RunningStats<double>> stats = columnStats(m, policy);
+    columnMeans(means, m, policy);
+    columnVariances(variances, m, policy);
+    columnMinMax(mins, maxes, m, policy);
+    for(unsigned j = 0; j < cols; j++){
+      for(unsigned i = 0; i < rows; i++) column[i] = m(i, j);
+      double mu = mean(column), var = variance(column.data, rows);
+      ok = ok && stats[j].count == rows && std::fabs(stats[j].mean - mu) < 1e-6 && std::fabs(means[j] - mu) < 1e-6;
+      ok = ok && std::fabs(variances[j] - var) < 1e-6 * var && mins[j] == min(column) && maxes[j] == max(column);
+    }
+    OwnedArray<RunningStats<double>> byRow = rowStats(m, policy);
+    ok = ok && byRow.length == rows && std::fabs(byRow[7].mean - mean(m.row(7))) < 1e-6;
+    
+    //A matrix with no rows has empty column accumulators (columnMeans and the rest reject it, see testChecks).
+    Matrix<double> noRows(0, cols);
+    OwnedArray<RunningStats<double>> emptyStats = columnStats(noRows, policy);
+    ok = ok && emptyStats.length == cols && emptyStats[0].count == 0 && emptyStats[cols - 1].count == 0 && rowStats(noRows, policy).length == 0;
+  }
+  
+  //Jagged input is copied into one allocation.
+  std::vector<Array<double>> jagged;
+  for(unsigned i = 0; i < rows; i++) jagged.push_back(m.row(i));
+  Matrix<double> copy = Matrix<double>::fromRows(Array<Array<double>>(jagged.data(), rows));
+  OwnedArray<double> jaggedMeans = OwnedArray<double>(cols);
+  vectorMean(jaggedMeans, Array<Array<double>>(jagged.data(), rows));
+  vectorMean(means, copy);
+  for(unsigned j = 0; j < cols; j++){
+    ok = ok && std::fabs(means[j] - jaggedMeans[j]) < 1e-6;
+  }
+  Matrix<double> moved = std::move(copy);
+  return ok && moved.view() == m.view() && copy.rows == 0;
+}
+
+bool testStrided(){
+  const unsigned rows = 300, cols = 7;
+  Matrix<double> m(rows, cols);
+  std::mt19937 gen(19);
+  for(unsigned i = 0; i < rows * cols; i++){
+    m.elements[i] = (double)(gen() % 10000) / 100 - 50;
+  }
+  
+  //A column view matches a copied column, through both the strided and the contiguous functions.
+  OwnedArray<double> column = OwnedArray<double>(rows), other = OwnedArray<double>(rows);
+  StridedArray<double> c2 = m.column(2), c5 = m.column(5);
+  for(unsigned i = 0; i < rows; i++){
+    column[i] = m(i, 2);
+    other[i] = m(i, 5);
+  }
+  OwnedArray<double> gathered = c2.materialize();
+  bool ok = gathered.view() == column.view() && &c2[4] == &m(4, 2) && !c2.contiguous();
+  ok = ok && std::fabs(sumTerms(c2) - sumTerms(column)) < 1e-9 && std::fabs(mean(c2) - mean(column)) < 1e-9;
+  ok = ok && std::fabs(l1Norm(c2) - l1Norm(column)) < 1e-9 && std::fabs(l2Norm(c2) - l2Norm(column)) < 1e-9 && lInfNorm(c2) == lInfNorm(column);
+  ok = ok && maxIndex(c2) == maxIndex(column) && minIndex(c2) == minIndex(column) && max(c2) == max(column) && min(c2) == min(column);
+  ok = ok && std::fabs(dotProduct(c2, c5) - dotProduct(column, other)) < 1e-9 && std::fabs(distance(c2, c5) - distance(column, other)) < 1e-9;
+  ok = ok && std::fabs(variance(c2) - variance(column)) < 1e-9 && std::fabs(stdev(c2) - stdev(column)) < 1e-9;
+  ok = ok && runningStats(c2).count == rows && runningStats(c2).maximum == max(column);
+  
+  //Functional operators, with and without unit stride.
+  OwnedArray<double> doubled = c2.map([](double x){return 2 * x;});
+  OwnedArray<double> sums = c2.zip(c5, [](double a, double b){return a + b;});
+  ok = ok && doubled[17] == 2 * m(17, 2) && sums[17] == m(17, 2) + m(17, 5);
+  ok = ok && c2.fold<double>([](double a, double b){return a + b;}, 0) == column.fold<double>([](double a, double b){return a + b;}, 0);
+  c5.mapInPlace([](double x){return -x;});
+  ok = ok && m(9, 5) == -other[9];
+  
+  OwnedArray<int> ints = OwnedArray<int>::adopt(count(10));
+  StridedArray<int> evens = every(ints, 2), backwards = StridedArray<int>(ints).reversed();
+  ok = ok && evens.length == 5 && evens[4] == 8 && every(ints, 3).length == 4 && sumTerms(evens) == 20;
+  ok = ok && backwards[0] == 9 && backwards[9] == 0 && backwards.every(3).materialize()[3] == 0 && backwards.slice(2, 5)[0] == 7;
+  ok = ok && StridedArray<int>(ints).contiguous() && sumTerms(StridedArray<int>(ints)) == 45 && maxIndex(backwards) == 0 && minIndex(backwards) == 9;
+  
+  //N-D views: a 2 x 3 x 4 block, sliced, transposed and walked along each axis.
+  OwnedArray<int> block = OwnedArray<int>::adopt(count(24));
+  NDView<int, 3> cube(block, {2, 3, 4});
+  ok = ok && cube.size() == 24 && cube(1, 2, 3) == 23 && cube(1, 0, 2) == 14;
+  NDView<int, 2> face = cube.slice(0, 1);
+  ok = ok && face(2, 1) == 21 && cube.slice(2, 3)(1, 1) == 19;
+  NDView<int, 3> swapped = cube.transpose(0, 2);
+  ok = ok && swapped.shape[0] == 4 && swapped(3, 2, 1) == cube(1, 2, 3);
+  StridedArray<int> lane = cube.lane(1, {1, 0, 2});
+  ok = ok && lane.length == 3 && lane[0] == 14 && lane[2] == 22 && lane.stride == 4;
+  OwnedArray<int> flat = swapped.materialize();
+  ok = ok && flat[1] == 12 && flat[23] == 23 && swapped.fold<int>([](int a, int b){return a + b;}, 0) == 276;
+  return ok;
+}
+
+#ifdef VMATH_INSTRUMENT
+//Only built by make test_instrument.
+bool testInstrument(){
+  RingBufferSink ring(4);
+  std::ostringstream json;
+  JsonSink jsonSink(json);
+  OwnedArray<int> arr = OwnedArray<int>::adopt(count(100000));
+  
+  setInstrumentSink(&ring);
+  for(unsigned i = 0; i < 6; i++){
+    arr.mapParallel([](int v){return v + 1;}, 3, 0);
+  }
+  OwnedArray<int> sorted = arr.clone();
+  sorted.sort(ParallelPolicy(3, 0));
+  std::vector<CallRecord> calls = ring.snapshot();
+  bool ok = ring.recorded() == 7 && calls.size() == 4 && std::string(calls[3].operation) == "sort";
+  const CallRecord& map = calls[2];
+  unsigned tasks = 0;
+  for(unsigned i = 0; i < map.workers.size(); i++){
+    tasks += map.workers[i].tasks;
+  }
+  ok = ok && std::string(map.operation) == "mapParallel" && map.elements == 100000 && map.jobs == 1 && map.tasks == 3 && tasks == 3;
+  ok = ok && map.workers.size() == ThreadPool::global().concurrency() && map.imbalance() >= 1 && map.totalNs > 0;
+  ok = ok && calls[3].jobs >= 2; //The sorting and merging jobs of one call.
+  
+  setInstrumentSink(&jsonSink);
+  sumTerms(arr.view(), ParallelPolicy(2, 0));
+  setInstrumentSink(nullptr);
+  arr.mapParallel([](int v){return v;}, 3, 0);
+  std::string line = json.str();
+  return ok && ring.recorded() == 7 && line.find("\"operation\": \"reduceTerms\"") != std::string::npos && std::count(line.begin(), line.end(), '\n') == 1;
+}
+#endif
+
+//Runs f in a child process, returning whether it aborted.
+template<typename F> bool aborts(F f){
+  std::cout.flush();
+  pid_t pid = fork();
+  if(pid == 0){
+    freopen("/dev/null", "w", stderr); //The failure message is expected.
+    f();
+    _exit(0);
+  }
+  int status = 0;
+  waitpid(pid, &status, 0);
+  return WIFSIGNALED(status) && WTERMSIG(status) == SIGABRT;
+}
+
+bool testChecks(){
+  int data[3] = {4, 5, 6};
+  Array<int> arr(data, 3);
+  //at is checked whatever the policy.
+  bool ok = arr.at(2) == 6 && aborts([arr](){arr.at(3);}) && !aborts([arr](){arr[2];});
+#if VMATH_BOUNDS_CHECKS
+  ok = ok && aborts([arr](){arr[3];});
+  Matrix<int> m(2, 2, 0);
+  ok = ok && aborts([&m](){m(2, 0);}) && aborts([&m](){m.column(2);});
+  ok = ok && aborts([arr, &data](){distanceSquared(arr, Array<int>(data, 2));});
+#endif
+#if VMATH_CONTRACT_CHECKS
+  //Checked even in NDEBUG builds that turn contract checks on (see make test_checks).
+  ok = ok && aborts([arr](){arr.foldUnordered([](int a, int b){return a - b;});});
+  ok = ok && aborts([&data](){Array<int>(data, 0).foldUnordered([](int a, int b){return a + b;});});
+  //Strict positivity is checked in the same pass as the sums, on every path.
+  double withZero[4] = {0.5, 0.25, 0.25, 0};
+  ok = ok && aborts([&withZero](){entropyStrictPositive(withZero, 4);}) && aborts([&withZero](){entropyStrictPositive(withZero, 4, VectorizedPolicy());});
+  ok = ok && !aborts([&withZero](){entropyStrictPositive(withZero, 3, ParallelPolicy(2, 0));});
+  std::vector<float> longer(1024, 1.0f / 1023);
+  longer[5] = 0; //In the vector loop rather than the tail.
+  ok = ok && aborts([&longer](){entropyStrictPositive(longer.data(), 1024, VectorizedPolicy());});
+  //Nonnegativity likewise, for entropy.
+  double negative[2] = {1.5, -0.5};
+  ok = ok && aborts([&negative](){entropy(negative, 2);}) && aborts([&negative](){entropy(negative, 2, VectorizedPolicy());}) && aborts([&negative](){entropy(negative, 2, ParallelPolicy(2, 0));});
+  longer[5] = -longer[6];
+  longer[6] *= 2;
+  ok = ok && aborts([&longer](){entropy(longer.data(), 1024, VectorizedPolicy());}) && aborts([&longer](){entropy(longer.data(), 1024, ParallelPolicy(3, 0));});
+  longer[5] = longer[6] = 1.0f / 1023; //Zeros and all, now nonnegative and summing to 1.
+  longer[7] = 0;
+  ok = ok && !aborts([&longer](){entropy(longer.data(), 1024, VectorizedPolicy());}) && !aborts([&longer](){entropy(longer.data(), 1024, ParallelPolicy(3, 0));});
+  Matrix<double> noRows(0, 3);
+  OwnedArray<double> columns = OwnedArray<double>(3);
+  ok = ok && aborts([&noRows, &columns](){columnMeans(columns.view(), noRows);}) && aborts([&noRows, &columns](){columnMinMax(columns.view(), columns.view(), noRows, ParallelPolicy(2, 0));});
+#endif
+  return ok;
+}
+
+bool testSizes(){
+  bool ok = sizeof(ArraySize) >= sizeof(size_t);
+  
+  //Partitions of lengths past 2^32 are exact and contiguous.
+  const ArraySize huge = ((ArraySize)1 << 40) + 7;
+  ArraySize previous = 0;
+  for(unsigned i = 1; i <= 10; i++){
+    ArraySize bound = Array<char>::partitionBound(i, huge, 10);
+    ok = ok && bound == (ArraySize)((uint64_t)i * huge / 10) && bound >= previous; //i * huge still fits in 64 bits here.
+    previous = bound;
+  }
+  ok = ok && previous == huge;
+  
+  //The portable 128 bit product agrees with the one randomBelow uses.
+  std::mt19937_64 gen(3);
+  uint64_t edges[] = {0, 1, 0xffffffffull, 0x100000000ull, ~0ull};
+  for(unsigned t = 0; t < 1000; t++){
+    uint64_t a = (t < 25) ? edges[t % 5] : gen(), b = (t < 25) ? edges[t / 5] : gen();
+    uint64_t high, halvesHigh;
+    ok = ok && multiplyWide(a, b, high) == multiplyWideHalves(a, b, halvesHigh) && high == halvesHigh;
+  }
+  uint64_t high;
+  ok = ok && multiplyWideHalves(~0ull, ~0ull, high) == 1 && high == ~0ull - 1;
+  
+  //Views index past 2^32 without wrapping; a zero stride keeps every element on one cell, so nothing large is allocated.
+  char cell = 'x';
+  StridedArray<char> repeated = StridedArray<char>(&cell, huge, 0);
+  StridedArray<char> tail = repeated.slice(huge - 3, huge);
+  ok = ok && tail.length == 3 && &tail[2] == &cell && &repeated[huge - 1] == &cell;
+  Array<char> wide = Array<char>(&cell, huge);
+  ok = ok && wide.slice(0, (ArraySize)1 << 33).length == (ArraySize)1 << 33 && wide.take(huge).length == huge;
+  return ok;
+}
+
+bool testBitArray(){
+  bool ok = true;
+  std::mt19937 gen(9);
+  unsigned lengths[] = {0, 1, 63, 64, 65, 200, 1000};
+  for(unsigned level = 0; level < 3; level++){
+#ifdef VMATH_SIMD
+    simdLevelLimit() = (SimdLevel)level;
+#endif
+    for(unsigned l = 0; l < 7; l++){
+      unsigned n = lengths[l];
+      std::vector<bool> ra(n), rb(n);
+      BitArray a(n), b(n, true);
+      for(unsigned i = 0; i < n; i++){
+        ra[i] = gen() % 3 == 0;
+        rb[i] = gen() % 2 == 0;
+        a.set(i, ra[i]);
+        if(!rb[i]) b.reset(i);
+      }
+      BitArray andBits = a & b, orBits = a | b, xorBits = a ^ b, notBits = ~a, minus = a;
+      minus.andNot(b);
+      unsigned count = 0;
+      for(unsigned i = 0; i < n; i++){
+        count += ra[i];
+        ok = ok && a[i] == ra[i] && b[i] == rb[i] && andBits[i] == (ra[i] && rb[i]) && orBits[i] == (ra[i] || rb[i])
+           &&  xorBits[i] == (ra[i] != rb[i]) && notBits[i] == !ra[i] && minus[i] == (ra[i] && !rb[i]);
+      }
+      //Complementing must leave the bits past the end clear.
+      ok = ok && a.count() == count && notBits.count() == n - count && BitArray(n, true).count() == n;
+      
+      //Iteration visits exactly the set bits, in order.
+      std::vector<ArraySize> visited;
+      a.forEachSet([&](ArraySize i){visited.push_back(i);});
+      ArraySize at = a.findNext(0);
+      for(unsigned v = 0; v < visited.size(); v++){
+        ok = ok && ra[visited[v]] && at == visited[v];
+        at = a.findNext(at + 1);
+      }
+      ok = ok && visited.size() == count && at == n && a.any() == (count > 0);
+      
+      BitArray copy = a;
+      copy ^= a;
+      ok = ok && !copy.any() && copy == BitArray(n) && (a | a) == a;
+    }
+  }
+#ifdef VMATH_SIMD
+  simdLevelLimit() = SIMD_AVX512;
+#endif
+  
+  //Predicate masks agree with the predicate, serially and in parallel, and select what filter selects.
+  OwnedArray<int> values = OwnedArray<int>(5003);
+  for(unsigned i = 0; i < values.length; i++) values[i] = gen() % 100;
+  auto small = [](int v){return v < 30;};
+  BitArray mask = values.predicateMask(small);
+  ok = ok && mask.length == values.length;
+  for(unsigned i = 0; i < values.length; i++){
+    ok = ok && mask[i] == small(values[i]);
+  }
+  for(unsigned pc = 1; pc <= 5; pc++){
+    ok = ok && values.predicateMask(small, ParallelPolicy(pc, 0)) == mask;
+  }
+  OwnedArray<int> selected = values.filter(mask), filtered = values.filter(small), parallel = values.filterParallel(small, 3, 0);
+  ok = ok && selected.length == mask.count() && selected.view() == filtered.view() && parallel.view() == filtered.view();
+  ok = ok && values.filter(BitArray(values.length, true)).view() == values.view() && values.filter(BitArray(values.length)).length == 0;
+  return ok;
+}
+
 bool testFold(){
   double data[4] = {2, -2, 2, -2};
   Array<double> arr = Array<double>(data, 4);  
@@ -106,6 +990,174 @@ bool testFold(){
      &&  length2 == 4;
 }
 
+bool testFoldParallel(){
+  Array<int> arr = count(1000003);
+  long long n = arr.length;
+  
+  //Large enough that the old per-element recursion would exhaust the stack.
+  int maxSerial = arr.foldUnordered([](int a, int b){return a > b ? a : b;});
+  int maxParallel = arr.foldUnorderedParallel([](int a, int b){return a > b ? a : b;}, 7, 0);
+  int maxCl = arr.foldUnorderedParallel<int>([](int a, int b, int cl){return (a > b ? a : b) + cl;}, 0);
+  
+  long long sum = arr.foldParallel<long long>([](long long acc, int next){return acc + next;}, [](long long r0, long long r1){return r0 + r1;}, 0, 5, 0);
+  long long sumDefault = arr.foldParallel<long long>([](long long acc, int next){return acc + next;}, [](long long r0, long long r1){return r0 + r1;}, 0);
+  
+  arr.freeMemory();
+  return maxSerial == n - 1
+     &&  maxParallel == n - 1
+     &&  maxCl == n - 1
+     &&  sum == n * (n - 1) / 2
+     &&  sumDefault == sum;
+}
+
+//Compares each SIMD path of the distance functions with a scalar loop.
+template<typename T> bool testDistanceSimdType(){
+  const unsigned len = 1003;
+  Array<T> a = Array<T>(len), b = Array<T>(len), w = Array<T>(len);
+  Array<bool> sw = Array<bool>(len);
+  for(unsigned i = 0; i < len; i++){
+    a[i] = (T)(i % 17) / 4;
+    b[i] = (T)(i % 5) - 1;
+    w[i] = (T)(i % 3);
+    sw[i] = (i % 7) < 3;
+  }
+  BitArray bits = BitArray::fromBools(sw.data, len);
+  
+  bool ok = true;
+  for(unsigned level = 0; level < 3; level++){
+#ifdef VMATH_SIMD
+    simdLevelLimit() = (SimdLevel)level;
+#endif
+    for(unsigned n = 0; n <= len; n += 17){ //Short lengths exercise the scalar tails.
+      T ds = 0, dws = 0, dss = 0;
+      for(unsigned i = 0; i < n; i++){
+        ds += (a[i] - b[i]) * (a[i] - b[i]);
+        dws += (a[i] - b[i]) * (a[i] - b[i]) * w[i];
+        if(sw[i]) dss += (a[i] - b[i]) * (a[i] - b[i]);
+      }
+      T a6 = a[6];
+      a[6] = INFINITY; //Switched off, so it must not poison the switched distance.
+      ok = ok && std::abs(distanceSwitchedSquared(a.take(n), b.take(n), sw.take(n)) - dss) <= dss * 1e-5;
+      ok = ok && std::abs(distanceSwitchedSquared(a.data, b.data, bits.words.data(), n) - dss) <= dss * 1e-5;
+      a[6] = a6;
+      ok = ok && std::abs(distanceSquared(a.take(n), b.take(n)) - ds) <= ds * 1e-5
+         &&  std::abs(distanceWeightedSquared(a.take(n), b.take(n), w.take(n)) - dws) <= dws * 1e-5
+         &&  std::abs(distance(a.take(n), b.take(n)) - std::sqrt(ds)) <= 1e-3;
+    }
+  }
+#ifdef VMATH_SIMD
+  simdLevelLimit() = SIMD_AVX512;
+#endif
+  a.freeMemory();
+  b.freeMemory();
+  w.freeMemory();
+  sw.freeMemory();
+  return ok;
+}
+
+bool testDistanceSimd(){
+  return testDistanceSimdType<float>() && testDistanceSimdType<double>();
+}
+
+bool testPairwise(){
+  const unsigned qCount = 70, rCount = 300, dim = 37, k = 5;
+  std::mt19937 rng(7);
+  std::uniform_real_distribution<double> dist(-1, 1);
+  Array<double> queries = Array<double>(qCount * dim), refs = Array<double>(rCount * dim);
+  queries.forEach([&](double& v){v = dist(rng);});
+  refs.forEach([&](double& v){v = dist(rng);});
+  
+  Array<double> matrix = Array<double>(qCount * rCount);
+  Array<ArraySize> nnIndices = Array<ArraySize>(qCount * k);
+  Array<double> nnDistances = Array<double>(qCount * k);
+  distanceSquaredMatrix(matrix, queries, refs, dim);
+  nearestNeighborsSquared(nnIndices, nnDistances, k, queries, refs, dim);
+  
+  bool ok = true;
+  for(unsigned i = 0; i < qCount; i++){
+    std::vector<std::pair<double, unsigned> > row;
+    for(unsigned j = 0; j < rCount; j++){
+      double ds = distanceSquared(queries.data + i * dim, refs.data + j * dim, dim);
+      ok = ok && std::abs(matrix[i * rCount + j] - ds) < 1e-9;
+      row.push_back(std::make_pair(ds, j));
+    }
+    std::sort(row.begin(), row.end());
+    for(unsigned t = 0; t < k; t++){
+      ok = ok && nnIndices[i * k + t] == row[t].second && std::abs(nnDistances[i * k + t] - row[t].first) < 1e-9;
+    }
+  }
+  
+  //A NaN coordinate makes NaN distances, as distanceSquared does, and never a nearest neighbor.
+  queries[3 * dim + 2] = refs[10 * dim + 5] = std::numeric_limits<double>::quiet_NaN();
+  distanceSquaredMatrix(matrix, queries, refs, dim);
+  nearestNeighborsSquared(nnIndices, nnDistances, k, queries, refs, dim);
+  for(unsigned j = 0; j < rCount; j++){
+    ok = ok && std::isnan(matrix[3 * rCount + j]) && std::isnan(distanceSquared(queries.data + 3 * dim, refs.data + j * dim, dim));
+  }
+  for(unsigned i = 0; i < qCount; i++){
+    ok = ok && std::isnan(matrix[i * rCount + 10]);
+    for(unsigned t = 0; t < k && i != 3; t++){
+      ok = ok && nnIndices[i * k + t] != 10 && !std::isnan(nnDistances[i * k + t]);
+    }
+  }
+  
+  queries.freeMemory();
+  refs.freeMemory();
+  matrix.freeMemory();
+  nnIndices.freeMemory();
+  nnDistances.freeMemory();
+  return ok;
+}
+
+bool testRunningStats(){
+  //A large offset makes the textbook sum-of-squares formulas cancel catastrophically.
+  const unsigned len = 100003;
+  Array<double> x = Array<double>(len), y = Array<double>(len);
+  double sx = 0;
+  for(unsigned i = 0; i < len; i++){
+    x[i] = 1e9 + (i % 10);
+    y[i] = 1e9 - 2.0 * (i % 10) + ((i % 3 == 0) ? 1 : 0);
+    sx += (i % 10);
+  }
+  double mx = sx / len, m2 = 0;
+  for(unsigned i = 0; i < len; i++){
+    m2 += ((i % 10) - mx) * ((i % 10) - mx);
+  }
+  
+  RunningStats<double> stats = runningStats(x);
+  RunningStats<double> par = runningStatsParallel(x, ParallelPolicy(4, 1));
+  RunningStats<double> parSerial = runningStatsParallel(x, ParallelPolicy(4, len + 1));
+  RunningStats<double> streamed;
+  for(unsigned i = 0; i < len; i++){
+    streamed.add(x[i]);
+  }
+  RunningStats<double> merged = runningStats(x.take(1000));
+  merged.merge(runningStats(x.drop(1000)));
+  
+  RunningCovariance<double> cov = runningCovariance(x, y);
+  RunningCovariance<double> covPar = runningCovarianceParallel(x, y, ParallelPolicy(4, 1));
+  RunningCovariance<double> covSerial = runningCovarianceParallel(x, y, ParallelPolicy(4, len + 1));
+  
+  bool ok = true;
+  RunningStats<double> all[5] = {stats, par, parSerial, streamed, merged};
+  for(unsigned i = 0; i < 5; i++){
+    ok = ok && all[i].count == len
+       &&  std::abs(all[i].mean - (1e9 + mx)) < 1e-4
+       &&  std::abs(all[i].variance() - m2 / (len - 1)) < 1e-6
+       &&  all[i].minimum == 1e9 && all[i].maximum == 1e9 + 9;
+  }
+  ok = ok && std::abs(variance(x) - m2 / (len - 1)) < 1e-6
+     &&  std::abs(stdevBiased(x) - std::sqrt(m2 / len)) < 1e-6
+     &&  pcc(x, y) < -0.99 && pcc(x, y) > -1
+     &&  std::abs(cov.pcc() - covPar.pcc()) < 1e-9
+     &&  covSerial.c == cov.c
+     &&  std::abs(pcc(x, x) - 1) < 1e-9;
+  
+  x.freeMemory();
+  y.freeMemory();
+  return ok;
+}
+
 int main(){
 	if(!testMap()){
 		std::cout << "Map error." << std::endl;
@@ -113,9 +1165,15 @@ int main(){
 	if(!testMapParallel()){
 		std::cout << "Map Parallel error." << std::endl;
 	}
+	if(!testThreadPool()){
+		std::cout << "Thread pool error." << std::endl;
+	}
 	if(!testFilter()){
 		std::cout << "Filter error." << std::endl;
 	}
+	if(!testFilterParallel()){
+		std::cout << "Filter parallel error." << std::endl;
+	}
 	if(!testPredicates()){
 		std::cout << "Filter error." << std::endl;
 	}
@@ -128,7 +1186,75 @@ int main(){
 	if(!testZip()){
 		std::cout << "Zip error." << std::endl;
 	}
+	if(!testCallables()){
+		std::cout << "Callables error." << std::endl;
+	}
+	if(!testLazy()){
+		std::cout << "Lazy error." << std::endl;
+	}
+	if(!testOwnedArray()){
+		std::cout << "Owned array error." << std::endl;
+	}
+	if(!testAllocators()){
+		std::cout << "Allocators error." << std::endl;
+	}
+	if(!testArrayFile()){
+		std::cout << "ArrayFile error." << std::endl;
+	}
+	if(!testTextIO()){
+		std::cout << "TextIO error." << std::endl;
+	}
+	if(!testSort()){
+		std::cout << "Sort error." << std::endl;
+	}
+	if(!testParallelShuffle()){
+		std::cout << "Parallel shuffle error." << std::endl;
+	}
+	if(!testExtremes()){
+		std::cout << "Extremes error." << std::endl;
+	}
+	if(!testReductions()){
+		std::cout << "Reductions error." << std::endl;
+	}
+	if(!testEntropy()){
+		std::cout << "Entropy error." << std::endl;
+	}
+	if(!testMatrix()){
+		std::cout << "Matrix error." << std::endl;
+	}
+	if(!testStrided()){
+		std::cout << "Strided error." << std::endl;
+	}
+	if(!testMapDynamic()){
+		std::cout << "Dynamic map error." << std::endl;
+	}
+#ifdef VMATH_INSTRUMENT
+	if(!testInstrument()){
+		std::cout << "Instrument error." << std::endl;
+	}
+#endif
+	if(!testChecks()){
+		std::cout << "Checks error." << std::endl;
+	}
+	if(!testSizes()){
+		std::cout << "Sizes error." << std::endl;
+	}
+	if(!testBitArray()){
+		std::cout << "BitArray error." << std::endl;
+	}
 	if(!testFold()){
 		std::cout << "Fold error." << std::endl;
 	}
+	if(!testDistanceSimd()){
+		std::cout << "Distance SIMD error." << std::endl;
+	}
+	if(!testPairwise()){
+		std::cout << "Pairwise distance error." << std::endl;
+	}
+	if(!testRunningStats()){
+		std::cout << "Running stats error." << std::endl;
+	}
+	if(!testFoldParallel()){
+		std::cout << "Fold parallel error." << std::endl;
+	}
 }
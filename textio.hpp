@@ -0,0 +1,256 @@
+//Text IO
+//Fast formatting and parsing of numeric Arrays as text, built on std::to_chars and std::from_chars.
+
+//Two layouts are supported: the braced layout of Array::writeToStream ({1, 2, 3}), and a plain delimited layout (1,2,3) for exchanging data with other tools.
+//Floating point values are written in their shortest form that parses back to the same value, so writing and reading round-trips exactly.
+//Character types are treated as small integers, and bool is not supported.
+
+#ifndef TEXTIO_H
+#define TEXTIO_H
+
+#include <charconv>
+#include <string.h>
+#include <istream>
+#include <ostream>
+#include <vector>
+#include <type_traits>
+
+#include "array.hpp"
+
+#define TEXT_BUFFER_SIZE (1 << 16)
+#define TEXT_CHUNK_ELEMENTS (1 << 14)
+#define TEXT_MAX_CHARS 32 //Longest to_chars output of any arithmetic type.
+
+//Formats elements [first, last) of arr into out, each preceded by separator except the very first element of arr.  Returns the end of the written characters.
+//out must have room for (last - first) * (TEXT_MAX_CHARS + separatorLength) characters.
+template<typename T> char* formatTextRange(char* out, const Array<T> arr, ArraySize first, ArraySize last, const char* separator, unsigned separatorLength){
+  static_assert(std::is_arithmetic<T>::value && !std::is_same<T, bool>::value, "Text IO supports numeric element types.");
+  for(ArraySize i = first; i < last; i++){
+    if(i > 0){
+      for(unsigned j = 0; j < separatorLength; j++){
+        *out++ = separator[j];
+      }
+    }
+    out = std::to_chars(out, out + TEXT_MAX_CHARS, +arr.data[i]).ptr;
+  }
+  return out;
+}
+
+//Writes the elements of arr with separator between them.
+//Arrays of at least minToMultithread elements are formatted in chunks on the global thread pool, partitionCount chunks at a time; smaller ones are formatted through a single reused buffer.
+template<typename T> void writeTextElements(std::ostream& out, const Array<T> arr, const char* separator, unsigned separatorLength, unsigned partitionCount, unsigned minToMultithread){
+  const unsigned chunkBytes = TEXT_CHUNK_ELEMENTS * (TEXT_MAX_CHARS + separatorLength);
+  ArraySize chunkCount = (arr.length + TEXT_CHUNK_ELEMENTS - 1) / TEXT_CHUNK_ELEMENTS;
+  if(arr.length < minToMultithread || partitionCount <= 1 || chunkCount <= 1){
+    std::vector<char> buffer(TEXT_BUFFER_SIZE);
+    ArraySize perBuffer = TEXT_BUFFER_SIZE / (TEXT_MAX_CHARS + separatorLength);
+    for(ArraySize i = 0; i < arr.length; i += perBuffer){
+      ArraySize last = (arr.length - i > perBuffer) ? i + perBuffer : arr.length;
+      char* end = formatTextRange(buffer.data(), arr, i, last, separator, separatorLength);
+      out.write(buffer.data(), end - buffer.data());
+    }
+    return;
+  }
+
+  std::vector<std::vector<char> > buffers(partitionCount, std::vector<char>(chunkBytes));
+  std::vector<unsigned> used(partitionCount);
+  for(ArraySize round = 0; round < chunkCount; round += partitionCount){
+    unsigned roundChunks = (chunkCount - round > partitionCount) ? partitionCount : (unsigned)(chunkCount - round);
+    ThreadPool::global().run(roundChunks, [&](unsigned c){
+      ArraySize first = (round + c) * TEXT_CHUNK_ELEMENTS;
+      ArraySize last = (arr.length - first > TEXT_CHUNK_ELEMENTS) ? first + TEXT_CHUNK_ELEMENTS : arr.length;
+      used[c] = formatTextRange(buffers[c].data(), arr, first, last, separator, separatorLength) - buffers[c].data();
+    });
+    for(unsigned c = 0; c < roundChunks; c++){
+      out.write(buffers[c].data(), used[c]);
+    }
+  }
+}
+
+//Writes arr as {a, b, c}, the layout of Array::writeToStream.
+template<typename T> void writeBracedText(std::ostream& out, const Array<T> arr, unsigned partitionCount = ThreadPool::global().concurrency(), unsigned minToMultithread = 1 << 16){
+  out.put('{');
+  writeTextElements(out, arr, ", ", 2, partitionCount, minToMultithread);
+  out.put('}');
+}
+
+//Writes arr as a, b and c separated by delimiter, with no trailing delimiter or newline.
+template<typename T> void writeDelimitedText(std::ostream& out, const Array<T> arr, char delimiter = ',', unsigned partitionCount = ThreadPool::global().concurrency(), unsigned minToMultithread = 1 << 16){
+  writeTextElements(out, arr, &delimiter, 1, partitionCount, minToMultithread);
+}
+
+//Parsing
+
+inline bool isTextSpace(char c){
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v';
+}
+
+inline const char* skipTextSpace(const char* p, const char* end){
+  while(p != end && isTextSpace(*p)) p++;
+  return p;
+}
+
+//Parses one element at p into out, accepting a leading + as from_chars does not (but not a second sign after it).  Returns the end of the element, or nullptr if there isn't a valid one.
+template<typename T> const char* parseTextElement(const char* p, const char* end, std::vector<T>& out){
+  if(p != end && *p == '+'){
+    p++;
+    if(p != end && (*p == '-' || *p == '+')) return nullptr;
+  }
+  T v;
+  std::from_chars_result r = std::from_chars(p, end, v);
+  if(r.ec != std::errc() || r.ptr == p) return nullptr;
+  out.push_back(v);
+  return r.ptr;
+}
+
+//Reads text for the parsers below, either from a range in memory or from a stream through a buffer of TEXT_BUFFER_SIZE characters.
+//An element runs up to the next whitespace or punctuation character and is always whole in the buffer when parsed: if it runs past the end, the part already read is moved to the front of the buffer and the rest read in after it (the buffer only grows for an element longer than itself).
+class TextScanner {
+public:
+  TextScanner(const char* begin, const char* end) : in(nullptr), p(begin), end(end) { }
+  explicit TextScanner(std::istream& in) : in(&in), buffer(TEXT_BUFFER_SIZE), p(buffer.data()), end(buffer.data()) { }
+
+  //Skips whitespace, setting skipped if there was any.  Returns false at the end of the text.
+  bool skipSpace(bool* skipped = nullptr){
+    const char* start = p;
+    bool any = false;
+    while(true){
+      p = skipTextSpace(p, end);
+      any = any || p != start;
+      if(p != end || !refill()) break;
+      start = p;
+    }
+    if(skipped != nullptr) *skipped = any;
+    return p != end;
+  }
+
+  //The next character; only valid after skipSpace returned true.
+  char peek() const {
+    return *p;
+  }
+  void advance(){
+    p++;
+  }
+
+  //Parses the element at the current position into out.  Returns false unless the whole of it is a valid element.
+  template<typename T> bool parseElement(std::vector<T>& out, char delimiter){
+    //Usually the element ends inside the buffer, and parsing finds where.
+    const char* parsedEnd = parseTextElement(p, end, out);
+    if(parsedEnd != nullptr && parsedEnd != end && endsTextElement(*parsedEnd, delimiter)){
+      p = parsedEnd;
+      return true;
+    }
+    if(parsedEnd != nullptr) out.pop_back();
+    //Otherwise find its end, reading more of the stream if it runs past the buffer, and parse it whole.
+    size_t length = 0;
+    while(true){
+      while(p + length != end && !endsTextElement(p[length], delimiter)) length++;
+      if(p + length != end || !refill()) break;
+    }
+    const char* elementEnd = p + length;
+    if(parseTextElement(p, elementEnd, out) != elementEnd) return false;
+    p = elementEnd;
+    return true;
+  }
+
+  //A hint for reserving space for the values: the number of characters in memory.
+  size_t bufferedLength() const {
+    return end - p;
+  }
+
+private:
+  std::istream* in;
+  std::vector<char> buffer;
+  const char* p;
+  const char* end;
+
+  static bool endsTextElement(char c, char delimiter){
+    return isTextSpace(c) || c == delimiter || c == ',' || c == '{' || c == '}';
+  }
+
+  //Moves the unparsed characters to the front of the buffer, growing it if they fill it, and reads more after them.  Returns false if there was no more text.
+  bool refill(){
+    if(in == nullptr) return false;
+    size_t kept = end - p;
+    if(kept > 0) memmove(buffer.data(), p, kept);
+    if(kept == buffer.size()) buffer.resize(2 * buffer.size());
+    in->read(buffer.data() + kept, buffer.size() - kept);
+    size_t read = (size_t)in->gcount();
+    p = buffer.data();
+    end = buffer.data() + kept + read;
+    return read > 0;
+  }
+};
+
+//Parses {a, b, c} (with any whitespace around the elements), which may have only whitespace after the closing brace.  Returns false if the text is malformed.
+template<typename T> bool parseBracedText(TextScanner& text, OwnedArray<T>& out){
+  std::vector<T> values;
+  if(!text.skipSpace() || text.peek() != '{') return false;
+  text.advance();
+  if(!text.skipSpace()) return false;
+  if(text.peek() == '}'){
+    text.advance();
+  }
+  else{
+    while(true){
+      if(!text.parseElement(values, ',')) return false;
+      if(!text.skipSpace()) return false;
+      if(text.peek() == '}'){
+        text.advance();
+        break;
+      }
+      if(text.peek() != ',') return false;
+      text.advance();
+      if(!text.skipSpace()) return false;
+    }
+  }
+  if(text.skipSpace()) return false;
+  out = OwnedArray<T>(values.size());
+  std::copy(values.begin(), values.end(), out.data);
+  return true;
+}
+template<typename T> bool parseBracedText(const char* begin, const char* end, OwnedArray<T>& out){
+  TextScanner text(begin, end);
+  return parseBracedText(text, out);
+}
+
+//Parses elements separated by delimiter.  Whitespace around the delimiters is ignored, and whitespace alone also separates elements, so one element per line is accepted too.
+template<typename T> bool parseDelimitedText(TextScanner& text, OwnedArray<T>& out, char delimiter = ','){
+  std::vector<T> values;
+  values.reserve(text.bufferedLength() / 4);
+  bool more = text.skipSpace();
+  while(more){
+    if(!text.parseElement(values, delimiter)) return false;
+    bool spaced;
+    more = text.skipSpace(&spaced);
+    if(more && text.peek() == delimiter){
+      text.advance();
+      more = text.skipSpace();
+      if(!more) return false;
+    }
+    else if(more && !spaced){
+      return false; //Elements must be separated.
+    }
+  }
+  out = OwnedArray<T>(values.size());
+  std::copy(values.begin(), values.end(), out.data);
+  return true;
+}
+template<typename T> bool parseDelimitedText(const char* begin, const char* end, OwnedArray<T>& out, char delimiter = ','){
+  TextScanner text(begin, end);
+  return parseDelimitedText(text, out, delimiter);
+}
+
+//Reads an Array written by writeBracedText or writeToStream from the rest of in, a buffer at a time.  On failure returns false and leaves out unchanged.
+template<typename T> bool readBracedText(std::istream& in, OwnedArray<T>& out){
+  TextScanner text(in);
+  return parseBracedText(text, out);
+}
+
+//Reads an Array written by writeDelimitedText from the rest of in, a buffer at a time.  On failure returns false and leaves out unchanged.
+template<typename T> bool readDelimitedText(std::istream& in, OwnedArray<T>& out, char delimiter = ','){
+  TextScanner text(in);
+  return parseDelimitedText(text, out, delimiter);
+}
+
+#endif
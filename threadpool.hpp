@@ -0,0 +1,221 @@
+//Persistent thread pool
+//Provides a process-wide set of worker threads that the parallel operators in array.hpp submit their work to, so that a parallel call costs a wakeup rather than a thread creation and join per partition.
+
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <type_traits>
+
+#include "instrument.hpp"
+
+//A job is a function of a task index, run once for each index in [0, taskCount).
+//Tasks are claimed from a shared counter by the workers and by the calling thread, which works alongside them and returns once every task has finished.
+//Only one job runs at a time; other threads calling run block until the pool is free, and calls made from inside a task simply run serially on the current thread.
+//Tasks must not throw.
+//With VMATH_INSTRUMENT defined, jobs run inside an InstrumentScope have each thread's share timed into the scope's record (see instrument.hpp).
+class ThreadPool {
+public:
+  //Starts workerCount threads.  The calling thread of run always works too, so a pool with 0 workers runs everything serially.
+  ThreadPool(unsigned workerCount) : stopping(false), generation(0), busy(0), taskCount(0), invoke(nullptr), context(nullptr), call(nullptr), submitNs(0), nextTask(0) {
+    startWorkers(workerCount);
+  }
+
+  ~ThreadPool(){
+    stopWorkers();
+  }
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  unsigned workerCount() const {
+    return workers.size();
+  }
+
+  //Number of threads that take part in a job (the workers plus the caller).
+  unsigned concurrency() const {
+    return workers.size() + 1;
+  }
+
+  //Joins the current workers and starts workerCount new ones.  Must not be called from inside a task.
+  void resize(unsigned workerCount){
+    std::lock_guard<std::mutex> submitLock(submitMutex);
+    stopWorkers();
+    startWorkers(workerCount);
+  }
+
+  //Runs f(i) for each i in [0, taskCount), returning when all calls are complete.
+  template<typename F> void run(unsigned taskCount, F&& f){
+    typedef typename std::remove_reference<F>::type FTy;
+    if(taskCount == 0) return;
+#ifdef VMATH_INSTRUMENT
+    CallRecord* call = insideTask() ? nullptr : InstrumentScope::current();
+    uint64_t submitNs = 0;
+    if(call != nullptr){
+      submitNs = instrumentNow();
+      call->jobs++;
+      call->tasks += taskCount;
+      if(call->workers.size() < concurrency()) call->workers.resize(concurrency());
+    }
+#else
+    void* call = nullptr;
+    unsigned long long submitNs = 0;
+#endif
+    if(taskCount == 1 || workers.empty() || insideTask()){
+      for(unsigned i = 0; i < taskCount; i++){
+        f(i);
+      }
+#ifdef VMATH_INSTRUMENT
+      if(call != nullptr){
+        call->workers[0].tasks += taskCount;
+        call->workers[0].busyNs += instrumentNow() - submitNs;
+      }
+#endif
+      return;
+    }
+
+    std::lock_guard<std::mutex> submitLock(submitMutex);
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      //A worker may still be draining the previous job; it must be done reading the job fields before they are replaced.
+      doneCv.wait(lock, [this](){return busy == 0;});
+      this->taskCount = taskCount;
+      this->invoke = &invokeTask<FTy>;
+      this->context = (void*)&f;
+      this->call = call;
+      this->submitNs = submitNs;
+      nextTask.store(0, std::memory_order_relaxed);
+      generation++;
+    }
+    workCv.notify_all();
+
+    //The caller takes its share of the work rather than sleeping.
+    runTasks(taskCount, &invokeTask<FTy>, (void*)&f, 0, call, submitNs);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    doneCv.wait(lock, [this](){return busy == 0;});
+  }
+
+  //The pool used by the parallel operators.  It starts one worker per hardware thread beyond the caller's; use resize to change that.
+  static ThreadPool& global(){
+    static ThreadPool pool(defaultWorkerCount());
+    return pool;
+  }
+
+  static unsigned defaultWorkerCount(){
+    unsigned hw = std::thread::hardware_concurrency();
+    return (hw > 1) ? hw - 1 : 0;
+  }
+
+private:
+  typedef void (*InvokeFn)(void*, unsigned);
+#ifdef VMATH_INSTRUMENT
+  typedef CallRecord JobRecord;
+#else
+  typedef void JobRecord;
+#endif
+
+  template<typename F> static void invokeTask(void* ctx, unsigned i){
+    (*(F*)ctx)(i);
+  }
+
+  static bool& insideTask(){
+    static thread_local bool inside = false;
+    return inside;
+  }
+
+  //Runs tasks until none are left.  slot identifies the thread (0 for the caller) in the timing record call, if any.
+  template<typename Call> void runTasks(unsigned count, InvokeFn fn, void* ctx, unsigned slot, Call* call, unsigned long long submitNs){
+    insideTask() = true;
+#ifdef VMATH_INSTRUMENT
+    uint64_t beginNs = (call != nullptr) ? instrumentNow() : 0;
+    unsigned done = 0;
+#endif
+    for(unsigned i = nextTask.fetch_add(1, std::memory_order_relaxed); i < count; i = nextTask.fetch_add(1, std::memory_order_relaxed)){
+      fn(ctx, i);
+#ifdef VMATH_INSTRUMENT
+      done++;
+#endif
+    }
+#ifdef VMATH_INSTRUMENT
+    //Each thread writes only its own slot, and the caller reads the record after every thread has checked out of the job.
+    if(call != nullptr && done > 0){
+      WorkerTiming& w = call->workers[slot];
+      w.tasks += done;
+      w.busyNs += instrumentNow() - beginNs;
+      w.wakeNs += beginNs - submitNs;
+    }
+#else
+    (void)slot;
+    (void)call;
+    (void)submitNs;
+#endif
+    insideTask() = false;
+  }
+
+  void workerLoop(unsigned slot){
+    std::unique_lock<std::mutex> lock(mutex);
+    unsigned long seen = generation; //Workers started by resize must not pick up the last job again.
+    while(true){
+      workCv.wait(lock, [this, seen](){return stopping || generation != seen;});
+      if(stopping) return;
+      seen = generation;
+      busy++;
+      unsigned count = taskCount;
+      InvokeFn fn = invoke;
+      void* ctx = context;
+      JobRecord* jobCall = call;
+      unsigned long long jobSubmitNs = submitNs;
+      lock.unlock();
+
+      runTasks(count, fn, ctx, slot, jobCall, jobSubmitNs);
+
+      lock.lock();
+      busy--;
+      if(busy == 0) doneCv.notify_all();
+    }
+  }
+
+  void startWorkers(unsigned workerCount){
+    stopping = false;
+    workers.reserve(workerCount);
+    for(unsigned i = 0; i < workerCount; i++){
+      workers.push_back(std::thread([this, i](){workerLoop(i + 1);}));
+    }
+  }
+
+  void stopWorkers(){
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+    workCv.notify_all();
+    for(unsigned i = 0; i < workers.size(); i++){
+      workers[i].join();
+    }
+    workers.clear();
+  }
+
+  std::vector<std::thread> workers;
+  std::mutex submitMutex; //Serializes jobs.
+  std::mutex mutex;       //Guards the fields below, apart from nextTask.
+  std::condition_variable workCv;
+  std::condition_variable doneCv;
+
+  bool stopping;
+  unsigned long generation;
+  unsigned busy;
+
+  unsigned taskCount;
+  InvokeFn invoke;
+  void* context;
+  JobRecord* call;                //Timing record of the job, with VMATH_INSTRUMENT.
+  unsigned long long submitNs;
+  std::atomic<unsigned> nextTask;
+};
+
+#endif
@@ -10,8 +10,16 @@
 
 #include <cmath>
 #include <assert.h>
+#include <vector>
+#include <algorithm>
+#include <utility>
+#include <limits>
+#include <type_traits>
 
 #include "array.hpp"
+#include "matrix.hpp"
+#include "strided.hpp"
+#include "simd.hpp"
 
 /////////////////////
 //DOUBLE COMPARISON//
@@ -27,47 +35,58 @@ template<typename T> bool epsilonCompare(T t0, T t1){
 //MAX//
 ///////
 
-//Returns an index of a maximally valued T in data.  Requires > defined.
-template<typename T> unsigned maxIndex(T* data, unsigned len){
-  int maxIndex = 0;
-  for(unsigned i = 1; i < len; i++){
+template<bool Greatest, typename T> ArraySize extremeIndexParallel(T* data, ArraySize len, const ParallelPolicy& policy);
+
+//Returns an index of a maximally valued T in data (the first, if there are several).  Requires > defined.
+template<typename T> ArraySize maxIndex(T* data, ArraySize len){
+  ArraySize maxIndex = 0;
+  for(ArraySize i = 1; i < len; i++){
     if(data[i] > data[maxIndex]){
       maxIndex = i;
     }
   }
   return maxIndex;
 }
-template<typename T> unsigned maxIndex(Array<T> arr){
+#ifdef VMATH_SIMD
+template<> inline ArraySize maxIndex<float>(float* data, ArraySize len){
+  return (len == 0) ? 0 : simdDispatch<SimdMaxIndex>((const float*)data, len);
+}
+template<> inline ArraySize maxIndex<double>(double* data, ArraySize len){
+  return (len == 0) ? 0 : simdDispatch<SimdMaxIndex>((const double*)data, len);
+}
+#endif
+template<typename T> ArraySize maxIndex(Array<T> arr){
   return maxIndex(arr.data, arr.length);
 }
 
+//As maxIndex, with the partitions of the policy searched on the global thread pool.
+template<typename T> ArraySize maxIndex(T* data, ArraySize len, const ParallelPolicy& policy){
+  return extremeIndexParallel<true>(data, len, policy);
+}
+template<typename T> ArraySize maxIndex(Array<T> arr, const ParallelPolicy& policy){
+  return maxIndex(arr.data, arr.length, policy);
+}
+
 //Returns the maximum value in T.  Requires > defined.
-template<typename T> T max(T* data, unsigned len){
+template<typename T> T max(T* data, ArraySize len){
   return data[maxIndex<T>(data, len)];
 }
-template<typename T> unsigned max(Array<T> arr){
+template<typename T> T max(Array<T> arr){
   return max(arr.data, arr.length);
 }
 
 //Complicated function.  Returns the index of the maximum value if the maximum is unique.
-//Otherwise, it returns the - of a maximal index.
+//Otherwise, it returns the - of the first maximal index, negated in ArraySize: 0 - index, which wraps to ArraySize's width (2^64 - index with the default size_t) rather than to an int's or unsigned's.
+//So compare a result r with (ArraySize)0 - index, or test r >= len for a tie other than at index 0 and recover the index as 0 - r; comparing with a negative int goes wrong once ArraySize is wider than int.
 //Requires > defined.
-template<typename T> unsigned maxUniqueIndex(T* data, unsigned len){
-  unsigned maxIndex = 0;
-  bool tied = false;
-  for(unsigned i = 1; i < len; i++){
-    if(data[i] > data[maxIndex]){
-      maxIndex = i;
-      tied = false;
-    }
-    else if(data[i] == data[maxIndex]){
-      tied = true;
-    }
+template<typename T> ArraySize maxUniqueIndex(T* data, ArraySize len){
+  ArraySize maxIndex = ::maxIndex(data, len);
+  for(ArraySize i = maxIndex + 1; i < len; i++){
+    if(data[i] == data[maxIndex]) return -maxIndex;
   }
-  if(tied) return -maxIndex;
-  else return maxIndex;
+  return maxIndex;
 }
-template<typename T> unsigned maxUniqueIndex(Array<T> arr){
+template<typename T> ArraySize maxUniqueIndex(Array<T> arr){
   return maxUniqueIndex(arr.data, arr.length);
 }
 
@@ -75,24 +94,136 @@ template<typename T> unsigned maxUniqueIndex(Array<T> arr){
 //MIN//
 ///////
 
-//Returns a maximal index in data.  Requires < defined.
-template<typename T> unsigned minIndex(T* data, unsigned len){
-  int mi = 0;
-  for(unsigned i = 1; i < len; i++){
+//Returns a minimal index in data (the first, if there are several).  Requires < defined.
+template<typename T> ArraySize minIndex(T* data, ArraySize len){
+  ArraySize mi = 0;
+  for(ArraySize i = 1; i < len; i++){
     if(data[i] < data[mi]) mi = i;
   }
   return mi;
 }
-template<typename T> unsigned minIndex(Array<T> arr){
-  return minIndex(arr.data, arr.len);
+#ifdef VMATH_SIMD
+template<> inline ArraySize minIndex<float>(float* data, ArraySize len){
+  return (len == 0) ? 0 : simdDispatch<SimdMinIndex>((const float*)data, len);
+}
+template<> inline ArraySize minIndex<double>(double* data, ArraySize len){
+  return (len == 0) ? 0 : simdDispatch<SimdMinIndex>((const double*)data, len);
+}
+#endif
+template<typename T> ArraySize minIndex(Array<T> arr){
+  return minIndex(arr.data, arr.length);
+}
+
+//As minIndex, with the partitions of the policy searched on the global thread pool.
+template<typename T> ArraySize minIndex(T* data, ArraySize len, const ParallelPolicy& policy){
+  return extremeIndexParallel<false>(data, len, policy);
+}
+template<typename T> ArraySize minIndex(Array<T> arr, const ParallelPolicy& policy){
+  return minIndex(arr.data, arr.length, policy);
 }
 
 //Returns the minimum value in data.  Requires < defined.
-template<typename T> T min(T* data, unsigned len){
+template<typename T> T min(T* data, ArraySize len){
   return data[minIndex<T>(data, len)];
 }
-template<typename T> unsigned min(Array<T> arr){
-  return min(arr.data, arr.len);
+template<typename T> T min(Array<T> arr){
+  return min(arr.data, arr.length);
+}
+
+//Finds the first greatest (or least) element of each partition, then the first greatest (or least) of those.
+template<bool Greatest, typename T> ArraySize extremeIndexParallel(T* data, ArraySize len, const ParallelPolicy& policy){
+  VMATH_INSTRUMENT_SCOPE(Greatest ? "maxIndex" : "minIndex", len);
+  unsigned partitionCount = (unsigned)std::min<ArraySize>(policy.partitionCount, len);
+  if(len < policy.minToMultithread || partitionCount < 2){
+    return Greatest ? maxIndex(data, len) : minIndex(data, len);
+  }
+  std::vector<ArraySize> found(partitionCount);
+  ArraySize* out = found.data();
+  ThreadPool::global().run(partitionCount, [data, len, partitionCount, out](unsigned p){
+    ArraySize first = Array<T>::partitionBound(p, len, partitionCount);
+    ArraySize count = Array<T>::partitionBound(p + 1, len, partitionCount) - first;
+    out[p] = first + (Greatest ? maxIndex(data + first, count) : minIndex(data + first, count));
+  });
+  ArraySize best = found[0];
+  for(ArraySize p = 1; p < partitionCount; p++){
+    if(Greatest ? data[found[p]] > data[best] : data[found[p]] < data[best]) best = found[p];
+  }
+  return best;
+}
+
+/////////
+//TOP K//
+/////////
+
+//Offers candidate index i to a heap of the best k of the first seen candidates, kept with the worst on top.
+//better(i, j) says whether candidate i ranks before candidate j.
+template<typename B> void offerCandidate(ArraySize* heap, ArraySize k, ArraySize seen, ArraySize i, B& better){
+  if(seen < k){
+    heap[seen] = i;
+    std::push_heap(heap, heap + seen + 1, better);
+  }
+  else if(better(i, heap[0])){
+    std::pop_heap(heap, heap + k, better);
+    heap[k - 1] = i;
+    std::push_heap(heap, heap + k, better);
+  }
+}
+
+//Writes the indices of the k best elements of data (best first) to outIndices and their values to outValues, where an element is better than another if it is greater (or, if not Greatest, less), or equal and earlier.
+//Keeps a heap of the best k elements seen so far, so it takes O(len log k) time instead of sorting, and with a policy each partition keeps its own heap and the heaps are merged.
+//data must not contain NaNs.
+template<bool Greatest, typename T> void selectBest(ArraySize* outIndices, T* outValues, ArraySize k, T* data, ArraySize len, const ParallelPolicy& policy){
+  VMATH_CHECK_BOUNDS(k <= len);
+  if(k == 0) return;
+  auto better = [data](ArraySize i, ArraySize j){
+    return (Greatest ? data[i] > data[j] : data[i] < data[j]) || (data[i] == data[j] && i < j);
+  };
+  unsigned partitionCount = (unsigned)std::min<ArraySize>(policy.partitionCount, len);
+  if(len < policy.minToMultithread || partitionCount < 2) partitionCount = 1;
+
+  std::vector<ArraySize> heaps((size_t)partitionCount * k);
+  std::vector<ArraySize> heapSizes(partitionCount);
+  ArraySize* h = heaps.data();
+  ArraySize* sizes = heapSizes.data();
+  ThreadPool::global().run(partitionCount, [=](unsigned p){
+    auto b = better;
+    ArraySize first = Array<T>::partitionBound(p, len, partitionCount);
+    ArraySize last = Array<T>::partitionBound(p + 1, len, partitionCount);
+    for(ArraySize i = first; i < last; i++){
+      offerCandidate(h + (size_t)p * k, k, i - first, i, b);
+    }
+    sizes[p] = std::min(k, last - first);
+  });
+  ArraySize* heap = h;
+  ArraySize seen = sizes[0];
+  for(ArraySize p = 1; p < partitionCount; p++){
+    for(ArraySize t = 0; t < sizes[p]; t++){
+      offerCandidate(heap, k, seen++, h[(size_t)p * k + t], better);
+    }
+  }
+  std::sort_heap(heap, heap + k, better);
+  for(ArraySize t = 0; t < k; t++){
+    outIndices[t] = heap[t];
+    outValues[t] = data[heap[t]];
+  }
+}
+
+//The k greatest elements, greatest first, with ties broken by lower index.  Requires > and == defined.
+template<typename T> void topK(ArraySize* outIndices, T* outValues, ArraySize k, T* data, ArraySize len, const ParallelPolicy& policy = ParallelPolicy(1)){
+  selectBest<true>(outIndices, outValues, k, data, len, policy);
+}
+template<typename T> void topK(Array<ArraySize> outIndices, Array<T> outValues, Array<T> arr, const ParallelPolicy& policy = ParallelPolicy(1)){
+  VMATH_CHECK_BOUNDS(outIndices.length == outValues.length); //k is the length of the outputs.
+  topK(outIndices.data, outValues.data, outIndices.length, arr.data, arr.length, policy);
+}
+
+//The k least elements, least first, with ties broken by lower index.  Requires < and == defined.
+template<typename T> void bottomK(ArraySize* outIndices, T* outValues, ArraySize k, T* data, ArraySize len, const ParallelPolicy& policy = ParallelPolicy(1)){
+  selectBest<false>(outIndices, outValues, k, data, len, policy);
+}
+template<typename T> void bottomK(Array<ArraySize> outIndices, Array<T> outValues, Array<T> arr, const ParallelPolicy& policy = ParallelPolicy(1)){
+  VMATH_CHECK_BOUNDS(outIndices.length == outValues.length); //k is the length of the outputs.
+  bottomK(outIndices.data, outValues.data, outIndices.length, arr.data, arr.length, policy);
 }
 
 ////////////
@@ -101,80 +232,417 @@ template<typename T> unsigned min(Array<T> arr){
 
 //Note, T must be a scalar type for this to be logical.
 //Returns euclidean distance squared, requires - and * defined.
-template<typename T> T distanceSquared(T* d0, T* d1, unsigned len){
+template<typename T> T distanceSquared(T* d0, T* d1, ArraySize len){
   T ds = 0;
-  for(unsigned i = 0; i < len; i++){
+  for(ArraySize i = 0; i < len; i++){
     ds += (d0[i] - d1[i]) * (d0[i] - d1[i]);
   }
   return ds;
 }
+#ifdef VMATH_SIMD
+//Vectorized for float and double (see simd.hpp).
+template<> inline float distanceSquared<float>(float* d0, float* d1, ArraySize len){
+  return simdDispatch<SimdDistanceSquared>((const float*)d0, (const float*)d1, len);
+}
+template<> inline double distanceSquared<double>(double* d0, double* d1, ArraySize len){
+  return simdDispatch<SimdDistanceSquared>((const double*)d0, (const double*)d1, len);
+}
+#endif
 template<typename T> T distanceSquared(Array<T> arr0, Array<T> arr1){
-  assert(arr0.length == arr1.length); //Arrays must be identically sized.
+  VMATH_CHECK_BOUNDS(arr0.length == arr1.length); //Arrays must be identically sized.
   return distanceSquared(arr0.data, arr1.data, arr0.length);
 }
 
 //Returns euclidean distance, requires -, * and sqrt(T) defined.
-template<typename T> T distance(T* t0, T* t1, unsigned len){
+template<typename T> T distance(T* t0, T* t1, ArraySize len){
   return sqrt(distanceSquared<T>(t0, t1, len));
 }
 template<typename T> T distance(Array<T> arr0, Array<T> arr1){
-  assert(arr0.length == arr1.length); //Arrays must be identically sized.
+  VMATH_CHECK_BOUNDS(arr0.length == arr1.length); //Arrays must be identically sized.
   return distance(arr0.data, arr1.data, arr0.length);
 }
 
 //Preweights each component of the distance
-template<typename T> T distanceWeightedSquared(T* d0, T* d1, T* w, unsigned len){
+template<typename T> T distanceWeightedSquared(T* d0, T* d1, T* w, ArraySize len){
   T ds = 0;
-  for(unsigned i = 0; i < len; i++){
+  for(ArraySize i = 0; i < len; i++){
     ds += (d0[i] - d1[i]) * (d0[i]- d1[i]) * w[i];
   }
   return ds;
 }
+#ifdef VMATH_SIMD
+template<> inline float distanceWeightedSquared<float>(float* d0, float* d1, float* w, ArraySize len){
+  return simdDispatch<SimdDistanceWeightedSquared>((const float*)d0, (const float*)d1, (const float*)w, len);
+}
+template<> inline double distanceWeightedSquared<double>(double* d0, double* d1, double* w, ArraySize len){
+  return simdDispatch<SimdDistanceWeightedSquared>((const double*)d0, (const double*)d1, (const double*)w, len);
+}
+#endif
 template<typename T> T distanceWeightedSquared(Array<T> arr0, Array<T> arr1, Array<T> weights){
-  assert(arr0.length == arr1.length && arr1.length == weights.length); //Arrays must be identically sized.
+  VMATH_CHECK_BOUNDS(arr0.length == arr1.length && arr1.length == weights.length); //Arrays must be identically sized.
   return distanceWeightedSquared(arr0.data, arr1.data, weights.data, arr0.length);
 }
 
 //Returns preweighted euclidean distance.
-template<typename T> T distanceWeighted(T* d0, T* d1, T* w, unsigned len){
+template<typename T> T distanceWeighted(T* d0, T* d1, T* w, ArraySize len){
   return sqrt(distanceWeightedSquared(d0, d1, w, len));
 }
 template<typename T> T distanceWeighted(Array<T> arr0, Array<T> arr1, Array<T> weights){
-  assert(arr0.length == arr1.length && arr1.length == weights.length); //Arrays must be identically sized.
+  VMATH_CHECK_BOUNDS(arr0.length == arr1.length && arr1.length == weights.length); //Arrays must be identically sized.
   return distanceWeighted(arr0.data, arr1.data, weights.data, arr0.length);
 }
 
 //Returns distance squared, ignoring elements where w[i] = false.
-template<typename T> T distanceSwitchedSquared(T* d0, T* d1, bool* w, unsigned len){
+template<typename T> T distanceSwitchedSquared(T* d0, T* d1, bool* w, ArraySize len){
   T ds = 0;
-  for(unsigned i = 0; i < len; i++){
+  for(ArraySize i = 0; i < len; i++){
     if(w[i]) ds += (d0[i] - d1[i]) * (d0[i]- d1[i]);
   }
   return ds;
 }
+#ifdef VMATH_SIMD
+template<> inline float distanceSwitchedSquared<float>(float* d0, float* d1, bool* w, ArraySize len){
+  return simdDispatch<SimdDistanceSwitchedSquared>((const float*)d0, (const float*)d1, (const bool*)w, len);
+}
+template<> inline double distanceSwitchedSquared<double>(double* d0, double* d1, bool* w, ArraySize len){
+  return simdDispatch<SimdDistanceSwitchedSquared>((const double*)d0, (const double*)d1, (const bool*)w, len);
+}
+#endif
 template<typename T> T distanceSwitchedSquared(Array<T> arr0, Array<T> arr1, Array<bool> switches){
-  assert(arr0.length == arr1.length && arr1.length == switches.length); //Arrays must be identically sized.
+  VMATH_CHECK_BOUNDS(arr0.length == arr1.length && arr1.length == switches.length); //Arrays must be identically sized.
   return distanceSwitchedSquared(arr0.data, arr1.data, switches.data, arr0.length);
 }
 
+//As above, with the switches packed into bits as in BitArray: element i counts when bit i % 64 of w[i / 64] is set.
+template<typename T> T distanceSwitchedSquared(T* d0, T* d1, const BitWord* w, ArraySize len){
+  T ds = 0;
+  for(ArraySize i = 0; i < len; i++){
+    if((w[i / 64] >> (i % 64)) & 1) ds += (d0[i] - d1[i]) * (d0[i] - d1[i]);
+  }
+  return ds;
+}
+#ifdef VMATH_SIMD
+template<> inline float distanceSwitchedSquared<float>(float* d0, float* d1, const BitWord* w, ArraySize len){
+  return simdDispatch<SimdDistanceSwitchedBitsSquared>((const float*)d0, (const float*)d1, (const uint64_t*)w, len);
+}
+template<> inline double distanceSwitchedSquared<double>(double* d0, double* d1, const BitWord* w, ArraySize len){
+  return simdDispatch<SimdDistanceSwitchedBitsSquared>((const double*)d0, (const double*)d1, (const uint64_t*)w, len);
+}
+#endif
+template<typename T> T distanceSwitchedSquared(Array<T> arr0, Array<T> arr1, const BitArray& switches){
+  VMATH_CHECK_BOUNDS(arr0.length == arr1.length && arr1.length == switches.length); //Arrays must be identically sized.
+  return distanceSwitchedSquared(arr0.data, arr1.data, switches.words.data(), arr0.length);
+}
+
 //Returns distance, ignoring elements where w[i] = false.
-template<typename T> T distanceSwitched(T* d0, T* d1, bool* w, unsigned len){
+template<typename T> T distanceSwitched(T* d0, T* d1, bool* w, ArraySize len){
   return sqrt(distanceSwitchedSquared(d0, d1, w, len));
 }
 template<typename T> T distanceSwitched(Array<T> arr0, Array<T> arr1, Array<bool> switches){
-  assert(arr0.length == arr1.length && arr1.length == switches.length); //Arrays must be identically sized.
+  VMATH_CHECK_BOUNDS(arr0.length == arr1.length && arr1.length == switches.length); //Arrays must be identically sized.
   return distanceSwitched(arr0.data, arr1.data, switches.data, arr0.length);
 }
+template<typename T> T distanceSwitched(T* d0, T* d1, const BitWord* w, ArraySize len){
+  return sqrt(distanceSwitchedSquared(d0, d1, w, len));
+}
+template<typename T> T distanceSwitched(Array<T> arr0, Array<T> arr1, const BitArray& switches){
+  VMATH_CHECK_BOUNDS(arr0.length == arr1.length && arr1.length == switches.length); //Arrays must be identically sized.
+  return distanceSwitched(arr0.data, arr1.data, switches.words.data(), arr0.length);
+}
+
+/////////////////////
+//PAIRWISE DISTANCE//
+/////////////////////
+
+//Dot product, requires + and * defined.
+template<typename T> T dotProduct(T* d0, T* d1, ArraySize len){
+  T dot = 0;
+  for(ArraySize i = 0; i < len; i++){
+    dot += d0[i] * d1[i];
+  }
+  return dot;
+}
+#ifdef VMATH_SIMD
+template<> inline float dotProduct<float>(float* d0, float* d1, ArraySize len){
+  return simdDispatch<SimdDot>((const float*)d0, (const float*)d1, len);
+}
+template<> inline double dotProduct<double>(double* d0, double* d1, ArraySize len){
+  return simdDispatch<SimdDot>((const double*)d0, (const double*)d1, len);
+}
+#endif
+template<typename T> T dotProduct(Array<T> arr0, Array<T> arr1){
+  VMATH_CHECK_BOUNDS(arr0.length == arr1.length); //Arrays must be identically sized.
+  return dotProduct(arr0.data, arr1.data, arr0.length);
+}
+
+//Adds the dot products of len components of aCount rows of a with bCount rows of b into out[i * outStride + j].  Rows are stride elements apart.
+template<typename T> void dotProductTile(T* a, ArraySize aCount, T* b, ArraySize bCount, ArraySize stride, ArraySize len, T* out, ArraySize outStride){
+  for(ArraySize i = 0; i < aCount; i++){
+    for(ArraySize j = 0; j < bCount; j++){
+      out[(size_t)i * outStride + j] += dotProduct(a + (size_t)i * stride, b + (size_t)j * stride, len);
+    }
+  }
+}
+#ifdef VMATH_SIMD
+template<> inline void dotProductTile<float>(float* a, ArraySize aCount, float* b, ArraySize bCount, ArraySize stride, ArraySize len, float* out, ArraySize outStride){
+  simdDispatch<SimdDotTile>((const float*)a, aCount, (const float*)b, bCount, stride, len, out, outStride);
+}
+template<> inline void dotProductTile<double>(double* a, ArraySize aCount, double* b, ArraySize bCount, ArraySize stride, ArraySize len, double* out, ArraySize outStride){
+  simdDispatch<SimdDotTile>((const double*)a, aCount, (const double*)b, bCount, stride, len, out, outStride);
+}
+#endif
+
+//The pairwise functions below take sets of vectors as row-major matrices: vector i of a set occupies elements [i * dim, (i + 1) * dim).
+//They compare a block of queries against a block of references at a time, one block of components at a time, so that both blocks stay in cache while the dot products between them are computed.
+//Squared euclidean distance is computed by norm expansion, |q - r|^2 = |q|^2 + |r|^2 - 2 q.r, which turns the work into dot products.  Where distances are tiny relative to the norms the expansion loses precision to cancellation; results are clamped to be nonnegative.
+//Query blocks are distributed over the global thread pool.
+#define PAIRWISE_QUERY_BLOCK 64
+#define PAIRWISE_REFERENCE_BLOCK 128
+#define PAIRWISE_DIM_BLOCK 256
+
+//Squared norms of count row vectors, computed on the global thread pool.
+template<typename T> void rowNormsSquared(T* out, T* rows, ArraySize count, ArraySize dim){
+  const unsigned blockCount = (count + PAIRWISE_REFERENCE_BLOCK - 1) / PAIRWISE_REFERENCE_BLOCK;
+  ThreadPool::global().run(blockCount, [out, rows, count, dim](unsigned b){
+    ArraySize end = std::min(count, ((ArraySize)b + 1) * PAIRWISE_REFERENCE_BLOCK);
+    for(ArraySize i = (ArraySize)b * PAIRWISE_REFERENCE_BLOCK; i < end; i++){
+      T* row = rows + (size_t)i * dim;
+      out[i] = dotProduct(row, row, dim);
+    }
+  });
+}
+
+//Writes the squared distances between qCount queries and rCount references into tile[i * tileStride + j].
+template<typename T> void distanceSquaredBlock(T* tile, ArraySize tileStride, T* q, T* qNorms, ArraySize qCount, T* r, T* rNorms, ArraySize rCount, ArraySize dim){
+  for(ArraySize i = 0; i < qCount; i++){
+    for(ArraySize j = 0; j < rCount; j++){
+      tile[(size_t)i * tileStride + j] = 0;
+    }
+  }
+  for(ArraySize d = 0; d < dim; d += PAIRWISE_DIM_BLOCK){
+    dotProductTile(q + d, qCount, r + d, rCount, dim, std::min(dim - d, (ArraySize)PAIRWISE_DIM_BLOCK), tile, tileStride);
+  }
+  for(ArraySize i = 0; i < qCount; i++){
+    T* row = tile + (size_t)i * tileStride;
+    for(ArraySize j = 0; j < rCount; j++){
+      T ds = qNorms[i] + rNorms[j] - 2 * row[j];
+      row[j] = (ds < 0) ? 0 : ds; //Clamps rounding below zero, but lets NaN through.
+    }
+  }
+}
+
+//Writes the squared euclidean distance between query i and reference j to out[i * rCount + j].
+template<typename T> void distanceSquaredMatrix(T* out, T* queries, ArraySize qCount, T* refs, ArraySize rCount, ArraySize dim){
+  VMATH_INSTRUMENT_SCOPE("distanceSquaredMatrix", (unsigned long long)qCount * rCount);
+  std::vector<T> norms(qCount + rCount);
+  T* qNorms = norms.data();
+  T* rNorms = qNorms + qCount;
+  rowNormsSquared(qNorms, queries, qCount, dim);
+  rowNormsSquared(rNorms, refs, rCount, dim);
+
+  const unsigned blockCount = (qCount + PAIRWISE_QUERY_BLOCK - 1) / PAIRWISE_QUERY_BLOCK;
+  ThreadPool::global().run(blockCount, [=](unsigned b){
+    ArraySize q0 = (ArraySize)b * PAIRWISE_QUERY_BLOCK;
+    ArraySize qLen = std::min(qCount - q0, (ArraySize)PAIRWISE_QUERY_BLOCK);
+    for(ArraySize r0 = 0; r0 < rCount; r0 += PAIRWISE_REFERENCE_BLOCK){
+      ArraySize rLen = std::min(rCount - r0, (ArraySize)PAIRWISE_REFERENCE_BLOCK);
+      distanceSquaredBlock(out + (size_t)q0 * rCount + r0, rCount, queries + (size_t)q0 * dim, qNorms + q0, qLen, refs + (size_t)r0 * dim, rNorms + r0, rLen, dim);
+    }
+  });
+}
+template<typename T> void distanceSquaredMatrix(Array<T> out, Array<T> queries, Array<T> refs, ArraySize dim){
+  VMATH_CHECK_BOUNDS(dim > 0 && queries.length % dim == 0 && refs.length % dim == 0); //Sets must be whole vectors.
+  VMATH_CHECK_BOUNDS(out.length == (queries.length / dim) * (refs.length / dim));
+  distanceSquaredMatrix(out.data, queries.data, queries.length / dim, refs.data, refs.length / dim, dim);
+}
+
+//Writes the euclidean distance between query i and reference j to out[i * rCount + j].
+template<typename T> void distanceMatrix(T* out, T* queries, ArraySize qCount, T* refs, ArraySize rCount, ArraySize dim){
+  distanceSquaredMatrix(out, queries, qCount, refs, rCount, dim);
+  for(size_t i = 0; i < (size_t)qCount * rCount; i++){
+    out[i] = sqrt(out[i]);
+  }
+}
+template<typename T> void distanceMatrix(Array<T> out, Array<T> queries, Array<T> refs, ArraySize dim){
+  VMATH_CHECK_BOUNDS(dim > 0 && queries.length % dim == 0 && refs.length % dim == 0); //Sets must be whole vectors.
+  VMATH_CHECK_BOUNDS(out.length == (queries.length / dim) * (refs.length / dim));
+  distanceMatrix(out.data, queries.data, queries.length / dim, refs.data, refs.length / dim, dim);
+}
+
+//For each query i, writes the indices of its k nearest references (nearest first) to outIndices[i * k, (i + 1) * k) and their squared distances to outDistances.
+//Ties are broken by lower reference index.  Only one block of the distance matrix per thread is held at a time.
+template<typename T> void nearestNeighborsSquared(ArraySize* outIndices, T* outDistances, ArraySize k, T* queries, ArraySize qCount, T* refs, ArraySize rCount, ArraySize dim){
+  VMATH_CHECK_CONTRACT(k > 0);
+  VMATH_CHECK_BOUNDS(k <= rCount);
+  std::vector<T> norms(qCount + rCount);
+  T* qNorms = norms.data();
+  T* rNorms = qNorms + qCount;
+  rowNormsSquared(qNorms, queries, qCount, dim);
+  rowNormsSquared(rNorms, refs, rCount, dim);
+
+  typedef std::pair<T, ArraySize> Candidate; //Ordered by distance, then index, so the heap top is the worst candidate kept.
+  const unsigned blockCount = (qCount + PAIRWISE_QUERY_BLOCK - 1) / PAIRWISE_QUERY_BLOCK;
+  ThreadPool::global().run(blockCount, [=](unsigned b){
+    ArraySize q0 = (ArraySize)b * PAIRWISE_QUERY_BLOCK;
+    ArraySize qLen = std::min(qCount - q0, (ArraySize)PAIRWISE_QUERY_BLOCK);
+    std::vector<T> tile((size_t)PAIRWISE_QUERY_BLOCK * PAIRWISE_REFERENCE_BLOCK);
+    std::vector<Candidate> heaps((size_t)qLen * k);
+    for(ArraySize r0 = 0; r0 < rCount; r0 += PAIRWISE_REFERENCE_BLOCK){
+      ArraySize rLen = std::min(rCount - r0, (ArraySize)PAIRWISE_REFERENCE_BLOCK);
+      distanceSquaredBlock(tile.data(), PAIRWISE_REFERENCE_BLOCK, queries + (size_t)q0 * dim, qNorms + q0, qLen, refs + (size_t)r0 * dim, rNorms + r0, rLen, dim);
+      for(ArraySize i = 0; i < qLen; i++){
+        Candidate* heap = heaps.data() + (size_t)i * k;
+        const T* row = tile.data() + (size_t)i * PAIRWISE_REFERENCE_BLOCK;
+        for(ArraySize j = 0; j < rLen; j++){
+          Candidate c(row[j], r0 + j);
+          ArraySize seen = r0 + j; //Candidates already offered to this heap.
+          if(seen < k){
+            heap[seen] = c;
+            std::push_heap(heap, heap + seen + 1);
+          }
+          else if(c < heap[0]){
+            std::pop_heap(heap, heap + k);
+            heap[k - 1] = c;
+            std::push_heap(heap, heap + k);
+          }
+        }
+      }
+    }
+    for(ArraySize i = 0; i < qLen; i++){
+      Candidate* heap = heaps.data() + (size_t)i * k;
+      std::sort_heap(heap, heap + k);
+      for(ArraySize t = 0; t < k; t++){
+        outDistances[(size_t)(q0 + i) * k + t] = heap[t].first;
+        outIndices[(size_t)(q0 + i) * k + t] = heap[t].second;
+      }
+    }
+  });
+}
+template<typename T> void nearestNeighborsSquared(Array<ArraySize> outIndices, Array<T> outDistances, ArraySize k, Array<T> queries, Array<T> refs, ArraySize dim){
+  VMATH_CHECK_BOUNDS(dim > 0 && queries.length % dim == 0 && refs.length % dim == 0); //Sets must be whole vectors.
+  VMATH_CHECK_BOUNDS(outIndices.length == (queries.length / dim) * k && outDistances.length == outIndices.length);
+  nearestNeighborsSquared(outIndices.data, outDistances.data, k, queries.data, queries.length / dim, refs.data, refs.length / dim, dim);
+}
+
+/////////////
+//REDUCTION//
+/////////////
+
+//Reduction ops: a reduction combines the term of each element with combine, starting from identity.
+//term replaces x by its term, and combine folds b into a.  Both are applied to single values and, in the SIMD kernels, to whole vectors, so they are written with operators that work on both, and update in place since vectors are not passed by value (see SimdVec).
+struct SumOp {
+  template<typename T> static T identity(){ return 0; }
+  template<typename V> static SIMD_INLINE void term(V&){ }
+  template<typename V> static SIMD_INLINE void combine(V& a, const V& b){ a += b; }
+  static const bool vectorizable = true;
+};
+struct ProductOp {
+  template<typename T> static T identity(){ return 1; }
+  template<typename V> static SIMD_INLINE void term(V&){ }
+  template<typename V> static SIMD_INLINE void combine(V& a, const V& b){ a *= b; }
+  static const bool vectorizable = true;
+};
+struct AbsSumOp {
+  template<typename T> static T identity(){ return 0; }
+  template<typename V> static SIMD_INLINE void term(V& x){ x = (x >= 0) ? x : -x; }
+  template<typename V> static SIMD_INLINE void combine(V& a, const V& b){ a += b; }
+  static const bool vectorizable = true;
+};
+struct SquareSumOp {
+  template<typename T> static T identity(){ return 0; }
+  template<typename V> static SIMD_INLINE void term(V& x){ x *= x; }
+  template<typename V> static SIMD_INLINE void combine(V& a, const V& b){ a += b; }
+  static const bool vectorizable = true;
+};
+//NaNs are skipped, as by the plain lInfNorm loop: a NaN b never replaces a, and a never becomes NaN.
+struct AbsMaxOp {
+  template<typename T> static T identity(){ return 0; }
+  template<typename V> static SIMD_INLINE void term(V& x){ x = (x >= 0) ? x : -x; }
+  template<typename V> static SIMD_INLINE void combine(V& a, const V& b){ a = (b > a) ? b : a; }
+  static const bool vectorizable = true;
+};
+//Reduces runs of up to REDUCE_BLOCK elements with several independent accumulators, and adds the run results pairwise, so rounding error grows with log(len) rather than len.
+#define REDUCE_BLOCK 1024
+
+//Folds the term of x into acc.
+template<typename Op, typename T> void reduceStep(T& acc, T x){
+  Op::term(x);
+  Op::combine(acc, x);
+}
+
+template<typename Op, typename T> T reduceBlock(Op, const T* data, ArraySize len){
+  T acc0 = Op::template identity<T>(), acc1 = acc0, acc2 = acc0, acc3 = acc0;
+  ArraySize i = 0;
+  for(; len - i >= 4; i += 4){
+    reduceStep<Op>(acc0, data[i]);
+    reduceStep<Op>(acc1, data[i + 1]);
+    reduceStep<Op>(acc2, data[i + 2]);
+    reduceStep<Op>(acc3, data[i + 3]);
+  }
+  for(; i < len; i++){
+    reduceStep<Op>(acc0, data[i]);
+  }
+  Op::combine(acc0, acc1);
+  Op::combine(acc2, acc3);
+  Op::combine(acc0, acc2);
+  return acc0;
+}
+#ifdef VMATH_SIMD
+template<typename Op, typename T> T reduceBlockSimd(Op op, const T* data, ArraySize len, std::true_type){
+  return simdDispatch<SimdReduce>(op, data, len);
+}
+template<typename Op, typename T> T reduceBlockSimd(Op op, const T* data, ArraySize len, std::false_type){
+  return reduceBlock<Op, T>(op, data, len);
+}
+template<typename Op> float reduceBlock(Op op, const float* data, ArraySize len){
+  return reduceBlockSimd(op, data, len, std::integral_constant<bool, Op::vectorizable>());
+}
+template<typename Op> double reduceBlock(Op op, const double* data, ArraySize len){
+  return reduceBlockSimd(op, data, len, std::integral_constant<bool, Op::vectorizable>());
+}
+#endif
+
+//Reduces with Op as the policy directs.  SequentialPolicy is a single accumulator, left to right.
+template<typename Op, typename T> T reduceTerms(const T* data, ArraySize len, SequentialPolicy){
+  T acc = Op::template identity<T>();
+  for(ArraySize i = 0; i < len; i++){
+    reduceStep<Op>(acc, data[i]);
+  }
+  return acc;
+}
+template<typename Op, typename T> T reduceTerms(const T* data, ArraySize len, VectorizedPolicy){
+  if(len <= REDUCE_BLOCK) return reduceBlock(Op(), data, len);
+  ArraySize half = (len / 2 + REDUCE_BLOCK - 1) / REDUCE_BLOCK * REDUCE_BLOCK; //Runs stay whole blocks.
+  T acc = reduceTerms<Op>(data, half, VectorizedPolicy());
+  Op::combine(acc, reduceTerms<Op>(data + half, len - half, VectorizedPolicy()));
+  return acc;
+}
+//Each partition is reduced as with VectorizedPolicy on the global thread pool, and the partition results are combined pairwise.
+template<typename Op, typename T> T reduceTerms(const T* data, ArraySize len, const ParallelPolicy& policy){
+  VMATH_INSTRUMENT_SCOPE("reduceTerms", len);
+  unsigned partitionCount = (unsigned)std::min<ArraySize>(policy.partitionCount, len);
+  if(len < policy.minToMultithread || partitionCount < 2) return reduceTerms<Op>(data, len, VectorizedPolicy());
+  std::vector<T> partials(partitionCount);
+  T* out = partials.data();
+  ThreadPool::global().run(partitionCount, [data, len, partitionCount, out](unsigned p){
+    ArraySize first = Array<T>::partitionBound(p, len, partitionCount);
+    out[p] = reduceTerms<Op>(data + first, Array<T>::partitionBound(p + 1, len, partitionCount) - first, VectorizedPolicy());
+  });
+  return Array<T>::treeReduce([](T a, const T& b){Op::combine(a, b); return a;}, out, partitionCount);
+}
 
 ////////////////
 //BASIC VECTOR//
 ////////////////
 
+//Each function below also takes an execution policy (SequentialPolicy, VectorizedPolicy or a ParallelPolicy, see array.hpp and reduceTerms).
+//The vectorized and parallel forms reorder the operations, so floating point results may differ from the plain loop in the last bits, generally being more accurate.
+
 //Sum calculation on arbitrary T.
 //Requires addition and identity.
-template<typename T> T sumTerms(T* data, unsigned len){ 
+template<typename T> T sumTerms(T* data, ArraySize len){ 
   T result = 0;
-  for(unsigned i = 0; i < len; i++){
+  for(ArraySize i = 0; i < len; i++){
     result += data[i];
   }
   return result;
@@ -182,12 +650,18 @@ template<typename T> T sumTerms(T* data, unsigned len){
 template<typename T> T sumTerms(Array<T> arr){
   return sumTerms(arr.data, arr.length);
 }
+template<typename T, typename Policy> T sumTerms(T* data, ArraySize len, const Policy& policy){
+  return reduceTerms<SumOp>((const T*)data, len, policy);
+}
+template<typename T, typename Policy> T sumTerms(Array<T> arr, const Policy& policy){
+  return sumTerms(arr.data, arr.length, policy);
+}
 
 //Product calculation on arbitrary T.
 //Requires product and identity.
-template<typename T> T productTerms(T* data, unsigned len){
+template<typename T> T productTerms(T* data, ArraySize len){
   T result = 1;
-  for(unsigned i = 0; i < len; i++){
+  for(ArraySize i = 0; i < len; i++){
     result *= data[i];
   }
   return result;
@@ -195,11 +669,17 @@ template<typename T> T productTerms(T* data, unsigned len){
 template<typename T> T productTerms(Array<T> arr){
   return productTerms(arr.data, arr.length);
 }
+template<typename T, typename Policy> T productTerms(T* data, ArraySize len, const Policy& policy){
+  return reduceTerms<ProductOp>((const T*)data, len, policy);
+}
+template<typename T, typename Policy> T productTerms(Array<T> arr, const Policy& policy){
+  return productTerms(arr.data, arr.length, policy);
+}
 
 //Returns the l1 norm of a vector of arbitrary T
-template<typename T> void l1Norm(T* data, unsigned len){
+template<typename T> T l1Norm(T* data, ArraySize len){
   T val = 0;
-  for(unsigned i = 0; i < len; i++){
+  for(ArraySize i = 0; i < len; i++){
     val += (data[i] >= 0) ? data[i] : -data[i];
   }
   return val;
@@ -207,13 +687,19 @@ template<typename T> void l1Norm(T* data, unsigned len){
 template<typename T> T l1Norm(Array<T> arr){
   return l1Norm(arr.data, arr.length);
 }
+template<typename T, typename Policy> T l1Norm(T* data, ArraySize len, const Policy& policy){
+  return reduceTerms<AbsSumOp>((const T*)data, len, policy);
+}
+template<typename T, typename Policy> T l1Norm(Array<T> arr, const Policy& policy){
+  return l1Norm(arr.data, arr.length, policy);
+}
 
 //Returns the l2 norm of a vector of arbitrary T.
 //Requires that sqrt is defined on T.
 //May be succeptible to numerics and overflow issues on narrow types with large values.
-template<typename T> void l2Norm(T* data, unsigned len){
+template<typename T> T l2Norm(T* data, ArraySize len){
   T sumSqrs = 0;
-  for(unsigned i = 0; i < len; i++){
+  for(ArraySize i = 0; i < len; i++){
     sumSqrs += data[i] * data[i];
   }
   return (T)sqrt(sumSqrs);
@@ -221,11 +707,17 @@ template<typename T> void l2Norm(T* data, unsigned len){
 template<typename T> T l2Norm(Array<T> arr){
   return l2Norm(arr.data, arr.length);
 }
+template<typename T, typename Policy> T l2Norm(T* data, ArraySize len, const Policy& policy){
+  return (T)sqrt(reduceTerms<SquareSumOp>((const T*)data, len, policy));
+}
+template<typename T, typename Policy> T l2Norm(Array<T> arr, const Policy& policy){
+  return l2Norm(arr.data, arr.length, policy);
+}
 
 //Returns the l infinity norm (or sup norm if you prefer) of a vector of arbitrary T.
-template<typename T> void lInfNorm(T* data, unsigned len){
+template<typename T> T lInfNorm(T* data, ArraySize len){
   double norm = 0;
-  for(unsigned i = 0; i < len; i++){
+  for(ArraySize i = 0; i < len; i++){
     double thisVal = (data[i] >= 0) ? data[i] : -data[i];
     if(thisVal > norm) norm = thisVal;
   }
@@ -234,35 +726,134 @@ template<typename T> void lInfNorm(T* data, unsigned len){
 template<typename T> T lInfNorm(Array<T> arr){
   return lInfNorm(arr.data, arr.length);
 }
+template<typename T, typename Policy> T lInfNorm(T* data, ArraySize len, const Policy& policy){
+  return reduceTerms<AbsMaxOp>((const T*)data, len, policy);
+}
+template<typename T, typename Policy> T lInfNorm(Array<T> arr, const Policy& policy){
+  return lInfNorm(arr.data, arr.length, policy);
+}
 
 #define LN_2 0.69314718055994528622676398299518041312694549560546875
 #define INV_LN_2 (1.0 / 0.69314718055994528622676398299518041312694549560546875)
-//Calculates the entropy of a vector.  Has the requirement that log be defined (natural logarithm), and that the input vector sums to 1 and is strictly positive.
-template<typename T> T entropyStrictPositive(T* data, unsigned len){
-  assert(epsilonCompare<T>(sumTerms<T>(data, len), (T)1)); //Assert that data sums to 1
-  double entropy = 0;
-  for(unsigned i = 0; i < len; i++){
-    assert(data[i] > 0); //Assert that input is strictly positive.
-    entropy += -data[i] * log(data[i]);// * INV_LN_2;
+//Entropy engine: the sum of the probabilities (for checking that they sum to 1) and their entropy are accumulated in a single pass.
+//With LOG_FAST, the vectorized and parallel forms take logs of float and double with the polynomial approximation of simdLog (see simd.hpp), whose error is below 2e-7 for float and 4e-16 for double, relative to max(1, |log(p)|).  As the logs are weighted by probabilities summing to 1, the approximation moves the entropy by at most that bound times (1 + the entropy in nats), on top of the rounding of the sums.
+//LOG_EXACT uses log from <cmath> everywhere, as the sequential form and the builds without VMATH_SIMD always do.
+enum LogAccuracy { LOG_FAST, LOG_EXACT };
+
+template<typename T> struct EntropySums {
+  T sum;
+  T entropy; //In nats.
+  bool allPositive; //No probability is zero, negative or NaN, for entropyStrictPositive.
+  bool allNonNegative; //No probability is negative or NaN, for entropy.
+};
+
+template<typename T> EntropySums<T> entropySumsBlock(const T* data, ArraySize len, LogAccuracy){
+  T sum0 = 0, sum1 = 0, ent0 = 0, ent1 = 0;
+  bool positive = true, nonNegative = true;
+  ArraySize i = 0;
+  for(; len - i >= 2; i += 2){
+    sum0 += data[i];
+    sum1 += data[i + 1];
+    ent0 += (data[i] <= 0) ? 0 : -data[i] * log(data[i]);
+    ent1 += (data[i + 1] <= 0) ? 0 : -data[i + 1] * log(data[i + 1]);
+    positive = positive & (data[i] > 0) & (data[i + 1] > 0);
+    nonNegative = nonNegative & (data[i] >= 0) & (data[i + 1] >= 0);
   }
-  return entropy * INV_LN_2; //Want natural log above, rather than multiplying by a constant for every term just multiply out here.
+  if(i < len){
+    sum0 += data[i];
+    ent0 += (data[i] <= 0) ? 0 : -data[i] * log(data[i]);
+    positive = positive & (data[i] > 0);
+    nonNegative = nonNegative & (data[i] >= 0);
+  }
+  EntropySums<T> r = {sum0 + sum1, ent0 + ent1, positive, nonNegative};
+  return r;
+}
+#ifdef VMATH_SIMD
+inline EntropySums<float> entropySumsBlock(const float* data, ArraySize len, LogAccuracy accuracy){
+  if(accuracy == LOG_EXACT) return entropySumsBlock<float>(data, len, accuracy);
+  EntropySums<float> r;
+  r.entropy = simdDispatch<SimdEntropy>(data, len, &r.sum, &r.allPositive, &r.allNonNegative);
+  return r;
+}
+inline EntropySums<double> entropySumsBlock(const double* data, ArraySize len, LogAccuracy accuracy){
+  if(accuracy == LOG_EXACT) return entropySumsBlock<double>(data, len, accuracy);
+  EntropySums<double> r;
+  r.entropy = simdDispatch<SimdEntropy>(data, len, &r.sum, &r.allPositive, &r.allNonNegative);
+  return r;
+}
+#endif
+
+//The plain loop, accumulating in double.
+template<typename T> EntropySums<T> entropySums(const T* data, ArraySize len, SequentialPolicy, LogAccuracy = LOG_EXACT){
+  double sum = 0, entropy = 0;
+  bool positive = true, nonNegative = true;
+  for(ArraySize i = 0; i < len; i++){
+    sum += data[i];
+    entropy += (data[i] <= 0) ? 0 : (-data[i] * log(data[i]));
+    positive = positive & (data[i] > 0);
+    nonNegative = nonNegative & (data[i] >= 0);
+  }
+  EntropySums<T> r = {(T)sum, (T)entropy, positive, nonNegative};
+  return r;
+}
+//Blocks of REDUCE_BLOCK probabilities, added pairwise as in reduceTerms.
+template<typename T> EntropySums<T> entropySums(const T* data, ArraySize len, VectorizedPolicy, LogAccuracy accuracy = LOG_FAST){
+  if(len <= REDUCE_BLOCK) return entropySumsBlock(data, len, accuracy);
+  ArraySize half = (len / 2 + REDUCE_BLOCK - 1) / REDUCE_BLOCK * REDUCE_BLOCK;
+  EntropySums<T> a = entropySums(data, half, VectorizedPolicy(), accuracy);
+  EntropySums<T> b = entropySums(data + half, len - half, VectorizedPolicy(), accuracy);
+  EntropySums<T> r = {a.sum + b.sum, a.entropy + b.entropy, a.allPositive && b.allPositive, a.allNonNegative && b.allNonNegative};
+  return r;
+}
+template<typename T> EntropySums<T> entropySums(const T* data, ArraySize len, const ParallelPolicy& policy, LogAccuracy accuracy = LOG_FAST){
+  VMATH_INSTRUMENT_SCOPE("entropy", len);
+  unsigned partitionCount = (unsigned)std::min<ArraySize>(policy.partitionCount, len);
+  if(len < policy.minToMultithread || partitionCount < 2) return entropySums(data, len, VectorizedPolicy(), accuracy);
+  std::vector<EntropySums<T> > partials(partitionCount);
+  EntropySums<T>* out = partials.data();
+  ThreadPool::global().run(partitionCount, [data, len, partitionCount, out, accuracy](unsigned p){
+    ArraySize first = Array<T>::partitionBound(p, len, partitionCount);
+    out[p] = entropySums(data + first, Array<T>::partitionBound(p + 1, len, partitionCount) - first, VectorizedPolicy(), accuracy);
+  });
+  return Array<EntropySums<T> >::treeReduce([](EntropySums<T> a, const EntropySums<T>& b){a.sum += b.sum; a.entropy += b.entropy; a.allPositive = a.allPositive && b.allPositive; a.allNonNegative = a.allNonNegative && b.allNonNegative; return a;}, out, partitionCount);
+}
+
+//Entropy in bits from the sums, checking that the probabilities sum to 1.
+template<typename T> T entropyFromSums(const EntropySums<T>& sums){
+  VMATH_CHECK_CONTRACT(epsilonCompare<T>(sums.sum, (T)1)); //Input must sum to 1.
+  return sums.entropy * INV_LN_2; //Want natural log above, rather than multiplying by a constant for every term just multiply out here.
+}
+
+//Calculates the entropy of a vector.  Has the requirement that log be defined (natural logarithm), and that the input vector sums to 1 and is strictly positive.
+template<typename T> T entropyStrictPositive(T* data, ArraySize len){
+  return entropyStrictPositive(data, len, SequentialPolicy());
 }
 template<typename T> T entropyStrictPositive(Array<T> arr){
   return entropyStrictPositive(arr.data, arr.length);
 }
+template<typename T, typename Policy> T entropyStrictPositive(T* data, ArraySize len, const Policy& policy, LogAccuracy accuracy = LOG_FAST){
+  EntropySums<T> sums = entropySums((const T*)data, len, policy, accuracy);
+  VMATH_CHECK_CONTRACT(sums.allPositive); //Input must be strictly positive; checked from the same pass.
+  return entropyFromSums(sums);
+}
+template<typename T, typename Policy> T entropyStrictPositive(Array<T> arr, const Policy& policy, LogAccuracy accuracy = LOG_FAST){
+  return entropyStrictPositive(arr.data, arr.length, policy, accuracy);
+}
 //Calculates the entropy of a vector.  Has the requirement that log be defined (natural logarithm), and that the input vector sums to 1 and is nonnegative.
-template<typename T> T entropy(T* data, unsigned len){
-  assert(epsilonCompare<T>(sumTerms<T>(data, len), (T)1)); //Assert that data sums to 1
-  double entropy = 0;
-  for(unsigned i = 0; i < len; i++){
-    assert(data[i] >= 0); //Assert that input is strictly nonnegative.
-    entropy += (data[i] <= 0) ? 0 : (-data[i] * log(data[i])/* * INV_LN_2 */);
-  }
-  return entropy * INV_LN_2;
+template<typename T> T entropy(T* data, ArraySize len){
+  return entropy(data, len, SequentialPolicy());
 }
 template<typename T> T entropy(Array<T> arr){
   return entropy(arr.data, arr.length);
 }
+template<typename T, typename Policy> T entropy(T* data, ArraySize len, const Policy& policy, LogAccuracy accuracy = LOG_FAST){
+  EntropySums<T> sums = entropySums((const T*)data, len, policy, accuracy);
+  VMATH_CHECK_CONTRACT(sums.allNonNegative); //Input must be nonnegative; checked from the same pass.
+  return entropyFromSums(sums);
+}
+template<typename T, typename Policy> T entropy(Array<T> arr, const Policy& policy, LogAccuracy accuracy = LOG_FAST){
+  return entropy(arr.data, arr.length, policy, accuracy);
+}
 
 /////////////////////////
 //VECTOR TRANSFORMATION//
@@ -270,19 +861,19 @@ template<typename T> T entropy(Array<T> arr){
 
 //Scalar multiplication on a vector.
 //Requires * defined
-template<typename T> void scalarMultiplyInPlace(T* data, unsigned len, T scalar){
-  for(unsigned i = 0; i < len; i++){
+template<typename T> void scalarMultiplyInPlace(T* data, ArraySize len, T scalar){
+  for(ArraySize i = 0; i < len; i++){
     data[i] *= scalar;
   }
 }
-template<typename T> void scalarMultiplyInPlace(Array<T> arr){
-  scalarMultiplyInPlace(arr.data, arr.length);
+template<typename T> void scalarMultiplyInPlace(Array<T> arr, T scalar){
+  scalarMultiplyInPlace(arr.data, arr.length, scalar);
 }
 
-//Scales a nonzero vector of finite values such that the L2 norm of the vector is equal to 0.
-//Requires *, +, sqrt defined and additive identity.
-template<typename T> void normalizeVectorInPlace(T* data, unsigned len){
-  scalarMultiplyInPlace<T>(data, len, l2Norm(data, len));
+//Scales a nonzero vector of finite values such that the L2 norm of the vector is equal to 1.
+//Requires *, /, +, sqrt defined and additive, multiplicative identities.
+template<typename T> void normalizeVectorInPlace(T* data, ArraySize len){
+  scalarMultiplyInPlace<T>(data, len, (T)1 / l2Norm(data, len));
 }
 template<typename T> void normalizeVectorInPlace(Array<T> arr){
   normalizeVectorInPlace(arr.data, arr.length);
@@ -290,7 +881,7 @@ template<typename T> void normalizeVectorInPlace(Array<T> arr){
 
 //Scales a nonzero vector of finite values such that the L2 norm of the vector is equal to val.
 //Requires +, *, / defined and additive, multiplicative identities.
-template<typename T> void normalizeVectorSumToValInPlace(T* data, unsigned len, T val){
+template<typename T> void normalizeVectorSumToValInPlace(T* data, ArraySize len, T val){
   scalarMultiplyInPlace<T>(data, len, val / sumTerms(data, len)); 
 }
 template<typename T> void normalizeVectorSumToValInPlace(Array<T> arr, T val){
@@ -299,7 +890,7 @@ template<typename T> void normalizeVectorSumToValInPlace(Array<T> arr, T val){
 
 //Scales a nonzero vector of finite values such that the L2 norm of the vector is equal to 1.
 //Requires +, *, / defined and additive, multiplicative identities.
-template<typename T> void normalizeVectorSumToOneInPlace(T* data, unsigned len){
+template<typename T> void normalizeVectorSumToOneInPlace(T* data, ArraySize len){
   normalizeVectorSumToValInPlace<T>(data, len, (T)1);
 }
 template<typename T> void normalizeVectorSumToOneInPlace(Array<T> arr){
@@ -312,7 +903,7 @@ template<typename T> void normalizeVectorSumToOneInPlace(Array<T> arr){
 
 //Mean calculation on arbitrary T.
 //Requires division, conversion from integer, and addition.
-template<typename T> T mean(T* data, unsigned len){
+template<typename T> T mean(T* data, ArraySize len){
   T result = sumTerms<T>(data, len);
   return result / len;
 }
@@ -320,11 +911,222 @@ template<typename T> T mean(Array<T> arr){
   return mean(arr.data, arr.length);
 }
 
+//Streaming statistics
+
+//Single pass, mergeable accumulator for count, mean, sum of squared deviations (M2), min and max.
+//Values may be added one at a time (Welford's update) or in bulk, and accumulators over disjoint data may be merged (Chan et al.'s update), so statistics can be gathered from streams or in parallel chunks.
+//Moments are kept in T when T is floating point, otherwise in double.
+#define STATS_BLOCK 256
+template<typename T> struct RunningStats {
+  typedef typename std::conditional<std::is_floating_point<T>::value, T, double>::type Real;
+
+  unsigned long long count;
+  Real mean;
+  Real m2;
+  T minimum;
+  T maximum;
+
+  RunningStats() : count(0), mean(0), m2(0), minimum(std::numeric_limits<T>::max()), maximum(std::numeric_limits<T>::lowest()) { }
+  RunningStats(unsigned long long count, Real mean, Real m2, T minimum, T maximum) : count(count), mean(mean), m2(m2), minimum(minimum), maximum(maximum) { }
+
+  void add(const T x){
+    count++;
+    Real delta = x - mean;
+    mean += delta / count;
+    m2 += delta * (x - mean);
+    if(x < minimum) minimum = x;
+    if(x > maximum) maximum = x;
+  }
+
+  //Adds len values a block at a time: the mean and M2 of each block are computed directly while it is in cache, then merged in.
+  //This reads the data from memory once, vectorizes, and avoids a division per element.
+  void add(const T* data, ArraySize len){
+    for(ArraySize b = 0; b < len; b += STATS_BLOCK){
+      const T* d = data + b;
+      ArraySize n = std::min(len - b, (ArraySize)STATS_BLOCK);
+      Real sum = 0;
+      T lo = d[0], hi = d[0];
+      for(ArraySize i = 0; i < n; i++){
+        sum += d[i];
+        lo = (d[i] < lo) ? d[i] : lo;
+        hi = (d[i] > hi) ? d[i] : hi;
+      }
+      Real m = sum / n;
+      Real ss = 0;
+      for(ArraySize i = 0; i < n; i++){
+        ss += (d[i] - m) * (d[i] - m);
+      }
+      merge(RunningStats(n, m, ss, lo, hi));
+    }
+  }
+
+  void merge(const RunningStats& o){
+    if(o.count == 0) return;
+    if(count == 0){
+      *this = o;
+      return;
+    }
+    unsigned long long n = count + o.count;
+    Real delta = o.mean - mean;
+    mean += delta * ((Real)o.count / n);
+    m2 += o.m2 + delta * delta * ((Real)count * o.count / n);
+    count = n;
+    if(o.minimum < minimum) minimum = o.minimum;
+    if(o.maximum > maximum) maximum = o.maximum;
+  }
+
+  Real variance() const {
+    return m2 / (count - 1);
+  }
+  Real varianceBiased() const {
+    return m2 / count;
+  }
+  Real stdev() const {
+    return sqrt(variance());
+  }
+  Real stdevBiased() const {
+    return sqrt(varianceBiased());
+  }
+};
+
+//Accumulator for two paired variables: the statistics of each and their co-moment (sum of products of deviations), giving covariance and correlation in one pass.
+template<typename T> struct RunningCovariance {
+  typedef typename RunningStats<T>::Real Real;
+
+  RunningStats<T> x;
+  RunningStats<T> y;
+  Real c;
+
+  RunningCovariance() : c(0) { }
+
+  void add(const T xv, const T yv){
+    Real dx = xv - x.mean;
+    x.add(xv);
+    y.add(yv);
+    c += dx * (yv - y.mean);
+  }
+
+  //Adds len pairs a block at a time, as RunningStats::add does.
+  void add(const T* xs, const T* ys, ArraySize len){
+    for(ArraySize b = 0; b < len; b += STATS_BLOCK){
+      const T* dx = xs + b;
+      const T* dy = ys + b;
+      ArraySize n = std::min(len - b, (ArraySize)STATS_BLOCK);
+      Real sx = 0, sy = 0;
+      T xlo = dx[0], xhi = dx[0], ylo = dy[0], yhi = dy[0];
+      for(ArraySize i = 0; i < n; i++){
+        sx += dx[i];
+        sy += dy[i];
+        xlo = (dx[i] < xlo) ? dx[i] : xlo;
+        xhi = (dx[i] > xhi) ? dx[i] : xhi;
+        ylo = (dy[i] < ylo) ? dy[i] : ylo;
+        yhi = (dy[i] > yhi) ? dy[i] : yhi;
+      }
+      Real mx = sx / n, my = sy / n;
+      Real sxx = 0, syy = 0, sxy = 0;
+      for(ArraySize i = 0; i < n; i++){
+        sxx += (dx[i] - mx) * (dx[i] - mx);
+        syy += (dy[i] - my) * (dy[i] - my);
+        sxy += (dx[i] - mx) * (dy[i] - my);
+      }
+      RunningCovariance block;
+      block.x = RunningStats<T>(n, mx, sxx, xlo, xhi);
+      block.y = RunningStats<T>(n, my, syy, ylo, yhi);
+      block.c = sxy;
+      merge(block);
+    }
+  }
+
+  void merge(const RunningCovariance& o){
+    if(o.x.count == 0) return;
+    if(x.count == 0){
+      *this = o;
+      return;
+    }
+    Real n = x.count + o.x.count;
+    c += o.c + (o.x.mean - x.mean) * (o.y.mean - y.mean) * ((Real)x.count * o.x.count / n);
+    x.merge(o.x);
+    y.merge(o.y);
+  }
+
+  Real covariance() const {
+    return c / (x.count - 1);
+  }
+  Real covarianceBiased() const {
+    return c / x.count;
+  }
+  //Pearson correlation coefficient.
+  Real pcc() const {
+    return c / sqrt(x.m2 * y.m2);
+  }
+};
+
+template<typename T> RunningStats<T> runningStats(T* data, ArraySize len){
+  RunningStats<T> stats;
+  stats.add(data, len);
+  return stats;
+}
+template<typename T> RunningStats<T> runningStats(Array<T> arr){
+  return runningStats(arr.data, arr.length);
+}
+
+//Accumulates partitions of the data on the global thread pool and merges them.
+template<typename T> RunningStats<T> runningStatsParallel(T* data, ArraySize len, const ParallelPolicy& policy = ParallelPolicy()){
+  VMATH_INSTRUMENT_SCOPE("runningStats", len);
+  unsigned partitionCount = (unsigned)std::min<ArraySize>(policy.partitionCount, len);
+  if(len < policy.minToMultithread || partitionCount < 2) return runningStats(data, len);
+  std::vector<RunningStats<T> > partials(partitionCount);
+  RunningStats<T>* out = partials.data();
+  ThreadPool::global().run(partitionCount, [=](unsigned i){
+    ArraySize start = Array<T>::partitionBound(i, len, partitionCount);
+    ArraySize finish = Array<T>::partitionBound(i + 1, len, partitionCount);
+    out[i].add(data + start, finish - start);
+  });
+  for(unsigned i = 1; i < partitionCount; i++){
+    out[0].merge(out[i]);
+  }
+  return out[0];
+}
+template<typename T> RunningStats<T> runningStatsParallel(Array<T> arr, const ParallelPolicy& policy = ParallelPolicy()){
+  return runningStatsParallel(arr.data, arr.length, policy);
+}
+
+template<typename T> RunningCovariance<T> runningCovariance(T* x, T* y, ArraySize len){
+  RunningCovariance<T> stats;
+  stats.add(x, y, len);
+  return stats;
+}
+template<typename T> RunningCovariance<T> runningCovariance(Array<T> arr0, Array<T> arr1){
+  VMATH_CHECK_BOUNDS(arr0.length == arr1.length);
+  return runningCovariance(arr0.data, arr1.data, arr0.length);
+}
+
+template<typename T> RunningCovariance<T> runningCovarianceParallel(T* x, T* y, ArraySize len, const ParallelPolicy& policy = ParallelPolicy()){
+  VMATH_INSTRUMENT_SCOPE("runningCovariance", len);
+  unsigned partitionCount = (unsigned)std::min<ArraySize>(policy.partitionCount, len);
+  if(len < policy.minToMultithread || partitionCount < 2) return runningCovariance(x, y, len);
+  std::vector<RunningCovariance<T> > partials(partitionCount);
+  RunningCovariance<T>* out = partials.data();
+  ThreadPool::global().run(partitionCount, [=](unsigned i){
+    ArraySize start = Array<T>::partitionBound(i, len, partitionCount);
+    ArraySize finish = Array<T>::partitionBound(i + 1, len, partitionCount);
+    out[i].add(x + start, y + start, finish - start);
+  });
+  for(unsigned i = 1; i < partitionCount; i++){
+    out[0].merge(out[i]);
+  }
+  return out[0];
+}
+template<typename T> RunningCovariance<T> runningCovarianceParallel(Array<T> arr0, Array<T> arr1, const ParallelPolicy& policy = ParallelPolicy()){
+  VMATH_CHECK_BOUNDS(arr0.length == arr1.length);
+  return runningCovarianceParallel(arr0.data, arr1.data, arr0.length, policy);
+}
+
 //Variance calculation on arbitrary T.
 //Requires division, conversion from integer, subtraction, and multiplication defined on T.
-template<typename T> T variance(T* data, T mean, unsigned len){
+template<typename T> T variance(T* data, T mean, ArraySize len){
   T result = 0;
-  for(unsigned i = 0; i < len; i++){
+  for(ArraySize i = 0; i < len; i++){
     result += (data[i] - mean) * (data[i] - mean);
   }
   return result / (len - 1);
@@ -333,8 +1135,9 @@ template<typename T> T variance(Array<T> arr, T mean){
   return variance(arr.data, mean, arr.length);
 }
 
-template<typename T> T variance(T* data, unsigned len){
-  return variance<T>(data, mean<T>(data, len), len);
+//Single pass (see RunningStats).
+template<typename T> T variance(T* data, ArraySize len){
+  return (T)runningStats(data, len).variance();
 }
 template<typename T> T variance(Array<T> arr){
   return variance(arr.data, arr.length);
@@ -342,14 +1145,14 @@ template<typename T> T variance(Array<T> arr){
 
 //Stdev calculation on arbitrary T.
 //Requires +, -, *, /, conversion from integer, and sqrt(T) all defined.
-template<typename T> T stdev(T* data, T mean, unsigned len){
+template<typename T> T stdev(T* data, T mean, ArraySize len){
   return (T)sqrt(variance<T>(data, mean, len));
 }
 template<typename T> T stdev(Array<T> arr, T mean){
   return stdev(arr.data, mean, arr.length);
 }
 
-template<typename T> T stdev(T* data, int len){
+template<typename T> T stdev(T* data, ArraySize len){
   return (T)sqrt(variance<T>(data, len));
 }
 template<typename T> T stdev(Array<T> arr){
@@ -359,9 +1162,9 @@ template<typename T> T stdev(Array<T> arr){
 
 //Biased variance calculation on arbitrary T.
 //Requires division, conversion from integer, subtraction, and multiplication defined on T.
-template<typename T> T varianceBiased(T* data, T mean, unsigned len){
+template<typename T> T varianceBiased(T* data, T mean, ArraySize len){
   T result = 0;
-  for(unsigned i = 0; i < len; i++){
+  for(ArraySize i = 0; i < len; i++){
     result += (data[i] - mean) * (data[i] - mean);
   }
   return result / len;
@@ -370,8 +1173,9 @@ template<typename T> T varianceBiased(Array<T> arr, T mean){
   return varianceBiased(arr.data, mean, arr.length);
 }
 
-template<typename T> T varianceBiased(T* data, unsigned len){
-  return varianceBiased<T>(data, mean<T>(data, len), len);
+//Single pass (see RunningStats).
+template<typename T> T varianceBiased(T* data, ArraySize len){
+  return (T)runningStats(data, len).varianceBiased();
 }
 template<typename T> T varianceBiased(Array<T> arr){
   return varianceBiased(arr.data, arr.length);
@@ -379,14 +1183,14 @@ template<typename T> T varianceBiased(Array<T> arr){
 
 //Stdev calculation on arbitrary T.
 //Requires +, -, *, /, conversion from integer, and sqrt(T) all defined.
-template<typename T> T stdevBiased(T* data, T mean, unsigned len){
+template<typename T> T stdevBiased(T* data, T mean, ArraySize len){
   return (T)sqrt(varianceBiased<T>(data, mean, len));
 }
 template<typename T> T stdevBiased(Array<T> arr, T mean){
   return stdevBiased(arr.data, mean, arr.length);
 }
 
-template<typename T> T stdevBiased(T* data, unsigned len){
+template<typename T> T stdevBiased(T* data, ArraySize len){
   return (T)sqrt(varianceBiased<T>(data, len));
 }
 template<typename T> T stdevBiased(Array<T> arr){
@@ -394,28 +1198,12 @@ template<typename T> T stdevBiased(Array<T> arr){
 }
 
 //PCC calculation
-//Code adapted from http://www.cs.tufts.edu/comp/135/pearson.html
-template<typename T> T pcc(T* x, T* y, unsigned len){
-  T ssx, ssy, cp, mx, my;
-  ssx = ssy = cp = mx = my = 0;
-  for(unsigned i = 0; i < len; i++){
-    ssx += x[i] * x[i];
-    ssy += y[i] * y[i];
-    cp += x[i] * y[i];
-    mx += x[i];
-    my += y[i];
-  }
-  mx /= len;
-  my /= len;
-  
-  T pop_sd_x = sqrt((ssx / len) - (mx * mx));
-  T pop_sd_y = sqrt((ssy / len) - (my * my));
-  T cov_xy = (cp / len) - (mx * my);
-  T pcc = cov_xy / (pop_sd_x * pop_sd_y);
-  return pcc;
+//Computed from the co-moment in a single pass (see RunningCovariance), rather than from raw sums of squares, which cancel catastrophically when the mean is large relative to the spread.
+template<typename T> T pcc(T* x, T* y, ArraySize len){
+  return (T)runningCovariance(x, y, len).pcc();
 }
 template<typename T> T pcc(Array<T> arr0, Array<T> arr1){
-  assert(arr0.length == arr1.length);
+  VMATH_CHECK_BOUNDS(arr0.length == arr1.length);
   return pcc(arr0.data, arr1.data, arr0.length);
 }
 
@@ -423,42 +1211,330 @@ template<typename T> T pcc(Array<T> arr0, Array<T> arr1){
 //VECTOR BASED//
 ////////////////
 
-template<typename T> void vectorMean(T* out, T** in, unsigned vLen, unsigned vCount){
-  for(unsigned i = 0; i < vLen; i++){
+template<typename T> void vectorMean(T* out, T** in, ArraySize vLen, ArraySize vCount){
+  for(ArraySize i = 0; i < vLen; i++){
     out[i] = 0;
   }
-  for(unsigned i = 0; i < vCount; i++){
-    for(unsigned j = 0; j < vLen; j++){
+  for(ArraySize i = 0; i < vCount; i++){
+    for(ArraySize j = 0; j < vLen; j++){
       out[j] += in[i][j];
     } 
   }
-  for(unsigned i = 0; i < vLen; i++){
+  for(ArraySize i = 0; i < vLen; i++){
     out[i] /= vCount;
   }
 }
 
 template<typename T> void vectorMean(Array<T> out, Array<Array<T>> in){
-  for(unsigned i = 0; i < out.length; i++){
-    out[i] = 0;
+  T* o = out.data;
+  for(ArraySize i = 0; i < out.length; i++){
+    o[i] = 0;
   }
-  for(unsigned i = 0; i < in.length; i++){
-    assert(in[i].length == out.length);
-    for(unsigned j = 0; j < out.length; j++){
-      out[j] += in[i][j];
+  for(ArraySize i = 0; i < in.length; i++){
+    VMATH_CHECK_BOUNDS(in.data[i].length == out.length);
+    const T* v = in.data[i].data;
+    for(ArraySize j = 0; j < out.length; j++){
+      o[j] += v[j];
     } 
   }
-  for(unsigned i = 0; i < out.length; i++){
-    out[i] /= in.length;
+  for(ArraySize i = 0; i < out.length; i++){
+    o[i] /= in.length;
   }
 }
 
+//Matrix statistics
+
+//Column statistics read a Matrix in tiles of STATS_BLOCK rows by MATRIX_COLUMN_BLOCK columns, each tile in row order, so memory is streamed through once while the per-column accumulators of a tile stay in registers or L1.
+//The loops over a tile row are independent across columns, so they vectorize without reassociating any sums.
+//Partitions of rows are processed on the global thread pool, and their results merged in order.
+#define MATRIX_COLUMN_BLOCK 64
+
+//Adds the sums of the columns of rows [first, last) of m into sums.
+template<typename T, typename Real> void addColumnSums(Real* sums, const Matrix<T>& m, ArraySize first, ArraySize last){
+  const ArraySize cols = m.cols;
+  Real acc[MATRIX_COLUMN_BLOCK];
+  for(ArraySize r0 = first; r0 < last; r0 += STATS_BLOCK){
+    ArraySize n = std::min(last - r0, (ArraySize)STATS_BLOCK);
+    for(ArraySize c0 = 0; c0 < cols; c0 += MATRIX_COLUMN_BLOCK){
+      ArraySize w = std::min(cols - c0, (ArraySize)MATRIX_COLUMN_BLOCK);
+      const T* tile = m.data() + (size_t)r0 * cols + c0;
+      for(ArraySize j = 0; j < w; j++){
+        acc[j] = 0;
+      }
+      for(ArraySize r = 0; r < n; r++){
+        const T* row = tile + (size_t)r * cols;
+        for(ArraySize j = 0; j < w; j++){
+          acc[j] += row[j];
+        }
+      }
+      for(ArraySize j = 0; j < w; j++){
+        sums[c0 + j] += acc[j];
+      }
+    }
+  }
+}
+
+//Adds rows [first, last) of m to the accumulators of its columns.  For each tile, the column sums, minima and maxima are taken in one sweep and the squared deviations from the tile means in a second while the tile is still in cache, and the tile's statistics are then merged in (as RunningStats::add does for a single vector).
+template<typename T> void addColumnStats(RunningStats<T>* stats, const Matrix<T>& m, ArraySize first, ArraySize last){
+  typedef typename RunningStats<T>::Real Real;
+  const ArraySize cols = m.cols;
+  Real sum[MATRIX_COLUMN_BLOCK], ss[MATRIX_COLUMN_BLOCK];
+  T lo[MATRIX_COLUMN_BLOCK], hi[MATRIX_COLUMN_BLOCK];
+  for(ArraySize r0 = first; r0 < last; r0 += STATS_BLOCK){
+    ArraySize n = std::min(last - r0, (ArraySize)STATS_BLOCK);
+    for(ArraySize c0 = 0; c0 < cols; c0 += MATRIX_COLUMN_BLOCK){
+      ArraySize w = std::min(cols - c0, (ArraySize)MATRIX_COLUMN_BLOCK);
+      const T* tile = m.data() + (size_t)r0 * cols + c0;
+      for(ArraySize j = 0; j < w; j++){
+        sum[j] = 0;
+        ss[j] = 0;
+        lo[j] = tile[j];
+        hi[j] = tile[j];
+      }
+      for(ArraySize r = 0; r < n; r++){
+        const T* row = tile + (size_t)r * cols;
+        for(ArraySize j = 0; j < w; j++){
+          sum[j] += row[j];
+          lo[j] = (row[j] < lo[j]) ? row[j] : lo[j];
+          hi[j] = (row[j] > hi[j]) ? row[j] : hi[j];
+        }
+      }
+      for(ArraySize j = 0; j < w; j++){
+        sum[j] /= n; //Now the tile means.
+      }
+      for(ArraySize r = 0; r < n; r++){
+        const T* row = tile + (size_t)r * cols;
+        for(ArraySize j = 0; j < w; j++){
+          Real d = row[j] - sum[j];
+          ss[j] += d * d;
+        }
+      }
+      for(ArraySize j = 0; j < w; j++){
+        stats[c0 + j].merge(RunningStats<T>(n, sum[j], ss[j], lo[j], hi[j]));
+      }
+    }
+  }
+}
+
+//Count, mean, variance, minimum and maximum of each column of m, in a single pass over m.
+//A matrix with no rows gives accumulators with count 0, as runningStats does for an empty vector; the functions below that read a mean or extreme out of them require rows.
+template<typename T> OwnedArray<RunningStats<T>> columnStats(const Matrix<T>& m, const ParallelPolicy& policy = ParallelPolicy()){
+  VMATH_INSTRUMENT_SCOPE("columnStats", m.elements.length);
+  OwnedArray<RunningStats<T>> stats = OwnedArray<RunningStats<T>>(m.cols);
+  unsigned partitionCount = (unsigned)std::min<ArraySize>(policy.partitionCount, m.rows);
+  if(m.elements.length < policy.minToMultithread || partitionCount < 2){
+    addColumnStats(stats.data, m, 0, m.rows);
+    return stats;
+  }
+  std::vector<RunningStats<T>> partials((size_t)partitionCount * m.cols);
+  RunningStats<T>* out = partials.data();
+  const Matrix<T>* mp = &m;
+  ThreadPool::global().run(partitionCount, [mp, out, partitionCount](unsigned p){
+    addColumnStats(out + (size_t)p * mp->cols, *mp, Array<T>::partitionBound(p, mp->rows, partitionCount), Array<T>::partitionBound(p + 1, mp->rows, partitionCount));
+  });
+  for(ArraySize p = 0; p < partitionCount; p++){
+    for(ArraySize j = 0; j < m.cols; j++){
+      stats.data[j].merge(out[(size_t)p * m.cols + j]);
+    }
+  }
+  return stats;
+}
+
+//Mean of each column of m, which must have rows.
+template<typename T> void columnMeans(Array<T> out, const Matrix<T>& m, const ParallelPolicy& policy = ParallelPolicy()){
+  VMATH_INSTRUMENT_SCOPE("columnMeans", m.elements.length);
+  typedef typename RunningStats<T>::Real Real;
+  VMATH_CHECK_BOUNDS(out.length == m.cols);
+  VMATH_CHECK_CONTRACT(m.rows > 0);
+  unsigned partitionCount = (unsigned)std::min<ArraySize>(policy.partitionCount, m.rows);
+  if(m.elements.length < policy.minToMultithread || partitionCount < 2) partitionCount = 1;
+  std::vector<Real> sums((size_t)partitionCount * m.cols);
+  Real* s = sums.data();
+  const Matrix<T>* mp = &m;
+  ThreadPool::global().run(partitionCount, [mp, s, partitionCount](unsigned p){
+    addColumnSums(s + (size_t)p * mp->cols, *mp, Array<T>::partitionBound(p, mp->rows, partitionCount), Array<T>::partitionBound(p + 1, mp->rows, partitionCount));
+  });
+  for(ArraySize j = 0; j < m.cols; j++){
+    Real total = 0;
+    for(ArraySize p = 0; p < partitionCount; p++){
+      total += s[(size_t)p * m.cols + j];
+    }
+    out.data[j] = (T)(total / m.rows);
+  }
+}
+
+//Unbiased variance of each column of m, which must have rows.
+template<typename T> void columnVariances(Array<T> out, const Matrix<T>& m, const ParallelPolicy& policy = ParallelPolicy()){
+  VMATH_CHECK_BOUNDS(out.length == m.cols);
+  VMATH_CHECK_CONTRACT(m.rows > 0);
+  OwnedArray<RunningStats<T>> stats = columnStats(m, policy);
+  for(ArraySize j = 0; j < m.cols; j++){
+    out.data[j] = (T)stats.data[j].variance();
+  }
+}
+
+//Minimum and maximum of each column of m, which must have rows.
+template<typename T> void columnMinMax(Array<T> outMin, Array<T> outMax, const Matrix<T>& m, const ParallelPolicy& policy = ParallelPolicy()){
+  VMATH_CHECK_BOUNDS(outMin.length == m.cols && outMax.length == m.cols);
+  VMATH_CHECK_CONTRACT(m.rows > 0);
+  OwnedArray<RunningStats<T>> stats = columnStats(m, policy);
+  for(ArraySize j = 0; j < m.cols; j++){
+    outMin.data[j] = stats.data[j].minimum;
+    outMax.data[j] = stats.data[j].maximum;
+  }
+}
+
+//Count, mean, variance, minimum and maximum of each row of m, with the rows divided among the global thread pool.
+template<typename T> OwnedArray<RunningStats<T>> rowStats(const Matrix<T>& m, const ParallelPolicy& policy = ParallelPolicy()){
+  VMATH_INSTRUMENT_SCOPE("rowStats", m.elements.length);
+  OwnedArray<RunningStats<T>> stats = OwnedArray<RunningStats<T>>(m.rows);
+  unsigned partitionCount = (unsigned)std::min<ArraySize>(policy.partitionCount, m.rows);
+  if(m.elements.length < policy.minToMultithread || partitionCount < 2) partitionCount = 1;
+  RunningStats<T>* out = stats.data;
+  const Matrix<T>* mp = &m;
+  ThreadPool::global().run(partitionCount, [mp, out, partitionCount](unsigned p){
+    ArraySize last = Array<T>::partitionBound(p + 1, mp->rows, partitionCount);
+    for(ArraySize i = Array<T>::partitionBound(p, mp->rows, partitionCount); i < last; i++){
+      out[i].add(mp->row(i).data, mp->cols);
+    }
+  });
+  return stats;
+}
+
+//The mean of the rows of a Matrix, as a vector.
+template<typename T> void vectorMean(Array<T> out, const Matrix<T>& in){
+  columnMeans(out, in);
+}
+
+/////////////////
+//STRIDED VIEWS//
+/////////////////
+
+//Overloads of the functions above for StridedArray (see strided.hpp), such as a column of a Matrix or every kth element of an Array.
+//Views with unit stride take the contiguous (and where available vectorized) loops; others are read in place, without copying.
+
+//Reduces a non-contiguous view with Op, with several independent accumulators as reduceBlock does.
+template<typename Op, typename T> T reduceStrided(const StridedArray<T> arr){
+  const T* d = arr.data;
+  const ptrdiff_t s = arr.stride;
+  T acc0 = Op::template identity<T>(), acc1 = acc0, acc2 = acc0, acc3 = acc0;
+  ArraySize i = 0;
+  for(; arr.length - i >= 4; i += 4){
+    reduceStep<Op>(acc0, d[(ptrdiff_t)i * s]);
+    reduceStep<Op>(acc1, d[(ptrdiff_t)(i + 1) * s]);
+    reduceStep<Op>(acc2, d[(ptrdiff_t)(i + 2) * s]);
+    reduceStep<Op>(acc3, d[(ptrdiff_t)(i + 3) * s]);
+  }
+  for(; i < arr.length; i++){
+    reduceStep<Op>(acc0, d[(ptrdiff_t)i * s]);
+  }
+  Op::combine(acc0, acc1);
+  Op::combine(acc2, acc3);
+  Op::combine(acc0, acc2);
+  return acc0;
+}
+
+template<typename T> T sumTerms(StridedArray<T> arr){
+  return arr.contiguous() ? sumTerms(arr.contiguousView()) : reduceStrided<SumOp>(arr);
+}
+template<typename T> T productTerms(StridedArray<T> arr){
+  return arr.contiguous() ? productTerms(arr.contiguousView()) : reduceStrided<ProductOp>(arr);
+}
+template<typename T> T l1Norm(StridedArray<T> arr){
+  return arr.contiguous() ? l1Norm(arr.contiguousView()) : reduceStrided<AbsSumOp>(arr);
+}
+template<typename T> T l2Norm(StridedArray<T> arr){
+  return arr.contiguous() ? l2Norm(arr.contiguousView()) : (T)sqrt(reduceStrided<SquareSumOp>(arr));
+}
+template<typename T> T lInfNorm(StridedArray<T> arr){
+  return arr.contiguous() ? lInfNorm(arr.contiguousView()) : reduceStrided<AbsMaxOp>(arr);
+}
+template<typename T> T mean(StridedArray<T> arr){
+  return sumTerms(arr) / arr.length;
+}
+
+template<typename T> ArraySize maxIndex(StridedArray<T> arr){
+  if(arr.contiguous()) return maxIndex(arr.contiguousView());
+  ArraySize maxIndex = 0;
+  for(ArraySize i = 1; i < arr.length; i++){
+    if(arr.data[(ptrdiff_t)i * arr.stride] > arr.data[(ptrdiff_t)maxIndex * arr.stride]){
+      maxIndex = i;
+    }
+  }
+  return maxIndex;
+}
+template<typename T> T max(StridedArray<T> arr){
+  return arr[maxIndex(arr)];
+}
+template<typename T> ArraySize minIndex(StridedArray<T> arr){
+  if(arr.contiguous()) return minIndex(arr.contiguousView());
+  ArraySize minIndex = 0;
+  for(ArraySize i = 1; i < arr.length; i++){
+    if(arr.data[(ptrdiff_t)i * arr.stride] < arr.data[(ptrdiff_t)minIndex * arr.stride]){
+      minIndex = i;
+    }
+  }
+  return minIndex;
+}
+template<typename T> T min(StridedArray<T> arr){
+  return arr[minIndex(arr)];
+}
+
+template<typename T> T dotProduct(StridedArray<T> arr0, StridedArray<T> arr1){
+  VMATH_CHECK_BOUNDS(arr0.length == arr1.length); //Arrays must be identically sized.
+  if(arr0.contiguous() && arr1.contiguous()) return dotProduct(arr0.contiguousView(), arr1.contiguousView());
+  T dot = 0;
+  for(ArraySize i = 0; i < arr0.length; i++){
+    dot += arr0.data[(ptrdiff_t)i * arr0.stride] * arr1.data[(ptrdiff_t)i * arr1.stride];
+  }
+  return dot;
+}
+template<typename T> T distanceSquared(StridedArray<T> arr0, StridedArray<T> arr1){
+  VMATH_CHECK_BOUNDS(arr0.length == arr1.length); //Arrays must be identically sized.
+  if(arr0.contiguous() && arr1.contiguous()) return distanceSquared(arr0.contiguousView(), arr1.contiguousView());
+  T ds = 0;
+  for(ArraySize i = 0; i < arr0.length; i++){
+    T d = arr0.data[(ptrdiff_t)i * arr0.stride] - arr1.data[(ptrdiff_t)i * arr1.stride];
+    ds += d * d;
+  }
+  return ds;
+}
+template<typename T> T distance(StridedArray<T> arr0, StridedArray<T> arr1){
+  return sqrt(distanceSquared(arr0, arr1));
+}
+
+//Non-contiguous views are gathered a STATS_BLOCK at a time into a buffer on the stack, so the blocked RunningStats::add still applies.
+template<typename T> RunningStats<T> runningStats(StridedArray<T> arr){
+  if(arr.contiguous()) return runningStats(arr.contiguousView());
+  RunningStats<T> stats;
+  T block[STATS_BLOCK];
+  for(ArraySize b = 0; b < arr.length; b += STATS_BLOCK){
+    ArraySize n = std::min(arr.length - b, (ArraySize)STATS_BLOCK);
+    arr.slice(b, b + n).copyTo(block);
+    stats.add(block, n);
+  }
+  return stats;
+}
+template<typename T> T variance(StridedArray<T> arr){
+  return (T)runningStats(arr).variance();
+}
+template<typename T> T stdev(StridedArray<T> arr){
+  return (T)runningStats(arr).stdev();
+}
+template<typename T> T varianceBiased(StridedArray<T> arr){
+  return (T)runningStats(arr).varianceBiased();
+}
+template<typename T> T stdevBiased(StridedArray<T> arr){
+  return (T)runningStats(arr).stdevBiased();
+}
+
 /////////////////////
 //ARRAY CONVENIENCE//
 /////////////////////
 
 //Sets each element of the given array to a value.
-template<typename T> void arraySet(T* array, unsigned length, T val){
-  for(unsigned i = 0; i < length; i++){
+template<typename T> void arraySet(T* array, ArraySize length, T val){
+  for(ArraySize i = 0; i < length; i++){
     array[i] = val;
   }
 }
@@ -467,7 +1543,7 @@ template<typename T> void arraySet(Array<T> arr, T val){
 }
 
 //Sets each element of the given array to 0.
-template<typename T> void arrayZero(T* array, unsigned length){
+template<typename T> void arrayZero(T* array, ArraySize length){
   arraySet<T>(array, length, 0);
 }
 template<typename T> void arrayZero(Array<T> arr){
@@ -475,25 +1551,25 @@ template<typename T> void arrayZero(Array<T> arr){
 }
 
 //Copies an array into another (must have the same length
-template<typename T> void arrayCopy(T* d, T* s, unsigned len){
-  for(unsigned i = 0; i < len; i++){
+template<typename T> void arrayCopy(T* d, T* s, ArraySize len){
+  for(ArraySize i = 0; i < len; i++){
     d[i] = s[i];
   }
 }
 template<typename T> void arrayCopy(Array<T> arr0, Array<T> arr1){
-  assert(arr0.length == arr1.length);
+  VMATH_CHECK_BOUNDS(arr0.length == arr1.length);
   arrayCopy(arr0.data, arr1.data, arr0.length);
 }
 
 //Copies an array into new memory
-template<typename T> T* arrayCopy(T* s, unsigned len){
+template<typename T> T* arrayCopy(T* s, ArraySize len){
   T* d = new T[len];
-  arrayCopy(s, d, len);
+  arrayCopy(d, s, len);
   return d;
 }
-template<typename T> Array<T> arrayCopy(Array<T> src){
-  Array<T> dest = Array<T>(src.length);
-  arrayCopy(dest, src);
+template<typename T> OwnedArray<T> arrayCopy(Array<T> src){
+  OwnedArray<T> dest = OwnedArray<T>(src.length);
+  arrayCopy(dest.data, src.data, src.length);
   return dest;
 }
 